@@ -0,0 +1,236 @@
+// Controller-to-synth latency probe
+//
+// Instances that share a probe name share its stamps and stage times:
+//   [latprobe stamp <probe>]          - Any message: stamp it, send the
+//                                       stamp id right, pass the message left
+//   [latprobe mark <probe> <stage>]   - Any message: time since its stamp
+//                                       into <stage>, pass the message on
+//   [latprobe measure <probe>]        - A mark for the 'total' stage, at the
+//                                       synth's note-on
+//   [latprobe report <probe>]         - bang: 'stage <name> <count> <mean us>
+//                                       <max us> <p99 us>' per stage, then
+//                                       'stamps <count>'; 'reset' clears them
+//
+// A mark times 'stamp <id>' against that stamp: send the id to
+// voice_leading's 'stamp' and it comes back on its info outlet just
+// before the chord, with or without 'async'. Anything else is timed
+// against the latest stamp. Each stage counts a stamp once, so a chord's
+// four note-ons add one 'total'. Times are CLOCK_MONOTONIC, so they
+// cover message handling and scheduling, not the audio buffer after the
+// note-on.
+//
+// Outlets: [passed through] [stamp id] (stamp only)
+
+#include "m_pd.h"
+#include "vl_stats.h"
+#include <string.h>
+
+#define PROBE_MAX 16        // Probe names per process
+#define PROBE_STAGES 16     // Stages per probe
+#define PROBE_STAMPS 64     // Stamps a mark can still find (power of two)
+#define PROBE_MAX_ID 16777216   // Ids stay exact as floats
+
+#define MODE_STAMP 0
+#define MODE_MARK 1
+#define MODE_REPORT 2
+
+typedef struct _probe_stage {
+    t_symbol *name;
+    unsigned int last_id;    // Stamp counted last, so each counts once
+    vl_stats_t stats;
+} probe_stage_t;
+
+typedef struct _probe {
+    t_symbol *name;
+    unsigned int next_id;
+    unsigned int ids[PROBE_STAMPS];
+    unsigned long long times[PROBE_STAMPS];
+    unsigned long stamps;
+    probe_stage_t stages[PROBE_STAGES];
+    int stage_count;
+} probe_t;
+
+// Built on first use and kept for good: a patch may recreate its
+// instances while stamps are still in flight
+static probe_t *probes[PROBE_MAX];
+
+static t_class *latprobe_class;
+
+typedef struct _latprobe {
+    t_object x_obj;
+    t_outlet *x_out;
+    t_outlet *x_out_id;
+
+    int mode;
+    probe_t *probe;
+    probe_stage_t *stage;
+} t_latprobe;
+
+static probe_t *probe_find(t_symbol *name) {
+    for (int i = 0; i < PROBE_MAX; i++) {
+        if (!probes[i]) {
+            probes[i] = (probe_t *)getbytes(sizeof(probe_t));
+            probes[i]->name = name;
+            probes[i]->next_id = 1;
+            return probes[i];
+        }
+        if (probes[i]->name == name) return probes[i];
+    }
+    return NULL;
+}
+
+static probe_stage_t *probe_stage(probe_t *probe, t_symbol *name) {
+    for (int i = 0; i < probe->stage_count; i++) {
+        if (probe->stages[i].name == name) return &probe->stages[i];
+    }
+    if (probe->stage_count == PROBE_STAGES) return NULL;
+
+    probe_stage_t *stage = &probe->stages[probe->stage_count++];
+    stage->name = name;
+    stage->last_id = 0;
+    vl_stats_reset(&stage->stats);
+    return stage;
+}
+
+static void latprobe_stamp(t_latprobe *x) {
+    probe_t *p = x->probe;
+    unsigned int id = p->next_id;
+    p->next_id = id + 1 < PROBE_MAX_ID ? id + 1 : 1;
+    p->ids[id & (PROBE_STAMPS - 1)] = id;
+    p->times[id & (PROBE_STAMPS - 1)] = vl_stats_now();
+    p->stamps++;
+    outlet_float(x->x_out_id, id);
+}
+
+// Time since stamp id (0: the latest one), if the stage hasn't counted it
+static void latprobe_mark(t_latprobe *x, unsigned int id) {
+    probe_t *p = x->probe;
+    unsigned long long now = vl_stats_now();
+    if (id == 0) {
+        if (p->stamps == 0) return;
+        id = p->next_id > 1 ? p->next_id - 1 : PROBE_MAX_ID - 1;
+    }
+    unsigned int slot = id & (PROBE_STAMPS - 1);
+    if (p->ids[slot] != id || x->stage->last_id == id) return;
+
+    x->stage->last_id = id;
+    vl_stats_add(&x->stage->stats, now - p->times[slot], 0, 0);
+}
+
+static void latprobe_report(t_latprobe *x) {
+    probe_t *p = x->probe;
+    for (int i = 0; i < p->stage_count; i++) {
+        const vl_stats_t *s = &p->stages[i].stats;
+        t_atom info[5];
+        SETSYMBOL(&info[0], p->stages[i].name);
+        SETFLOAT(&info[1], (t_float)s->calls);
+        SETFLOAT(&info[2], (t_float)(s->calls ? s->total_ns / 1e3 / s->calls : 0));
+        SETFLOAT(&info[3], (t_float)(s->max_ns / 1e3));
+        SETFLOAT(&info[4], (t_float)(vl_stats_percentile(s, 0.99) / 1e3));
+        outlet_anything(x->x_out, gensym("stage"), 5, info);
+    }
+
+    t_atom stamps;
+    SETFLOAT(&stamps, (t_float)p->stamps);
+    outlet_anything(x->x_out, gensym("stamps"), 1, &stamps);
+}
+
+static void latprobe_reset(t_latprobe *x) {
+    probe_t *p = x->probe;
+    for (int i = 0; i < p->stage_count; i++) {
+        vl_stats_reset(&p->stages[i].stats);
+    }
+    p->stamps = 0;
+    post("latprobe: %s reset", p->name->s_name);
+}
+
+// Every message: stamp or time it, then pass it on unchanged
+static void latprobe_anything(t_latprobe *x, t_symbol *s, int argc, t_atom *argv) {
+    if (x->mode == MODE_REPORT) {
+        if (s == &s_bang) {
+            latprobe_report(x);
+        } else if (s == gensym("reset")) {
+            latprobe_reset(x);
+        } else {
+            pd_error(x, "latprobe: report takes bang or reset");
+        }
+        return;
+    }
+
+    if (x->mode == MODE_STAMP) {
+        latprobe_stamp(x);
+    } else if (x->stage) {
+        int id = s == gensym("stamp") && argc > 0 ? (int)atom_getfloat(&argv[0]) : 0;
+        latprobe_mark(x, id > 0 ? (unsigned int)id : 0);
+    }
+    outlet_anything(x->x_out, s, argc, argv);
+}
+
+static void latprobe_bang(t_latprobe *x) {
+    latprobe_anything(x, &s_bang, 0, NULL);
+}
+
+static void latprobe_float(t_latprobe *x, t_floatarg f) {
+    t_atom a;
+    SETFLOAT(&a, f);
+    latprobe_anything(x, &s_float, 1, &a);
+}
+
+static void latprobe_list(t_latprobe *x, t_symbol *s, int argc, t_atom *argv) {
+    latprobe_anything(x, &s_list, argc, argv);
+}
+
+static void *latprobe_new(t_symbol *s, int argc, t_atom *argv) {
+    t_symbol *mode = argc > 0 ? atom_getsymbol(&argv[0]) : &s_;
+    t_symbol *name = argc > 1 ? atom_getsymbol(&argv[1]) : gensym("default");
+    t_symbol *stage = argc > 2 ? atom_getsymbol(&argv[2]) : gensym("total");
+
+    int kind;
+    if (mode == gensym("stamp")) {
+        kind = MODE_STAMP;
+    } else if (mode == gensym("mark") || mode == gensym("measure")) {
+        kind = MODE_MARK;
+        if (mode == gensym("measure")) stage = gensym("total");
+    } else if (mode == gensym("report")) {
+        kind = MODE_REPORT;
+    } else {
+        pd_error(0, "latprobe: mode is stamp|mark|measure|report, not '%s'", mode->s_name);
+        return NULL;
+    }
+    probe_t *probe = probe_find(name);
+    if (!probe) {
+        pd_error(0, "latprobe: more than %d probes", PROBE_MAX);
+        return NULL;
+    }
+
+    t_latprobe *x = (t_latprobe *)pd_new(latprobe_class);
+    x->mode = kind;
+    x->probe = probe;
+    x->stage = NULL;
+    if (x->mode == MODE_MARK) {
+        x->stage = probe_stage(x->probe, stage);
+        if (!x->stage) pd_error(x, "latprobe: %s has %d stages already, '%s' not timed",
+                                name->s_name, PROBE_STAGES, stage->s_name);
+    }
+
+    x->x_out = outlet_new(&x->x_obj, 0);
+    x->x_out_id = x->mode == MODE_STAMP ? outlet_new(&x->x_obj, &s_float) : NULL;
+
+    return (void *)x;
+}
+
+void latprobe_setup(void) {
+    latprobe_class = class_new(gensym("latprobe"),
+                               (t_newmethod)(t_method)latprobe_new,
+                               0,
+                               sizeof(t_latprobe),
+                               CLASS_DEFAULT,
+                               A_GIMME, 0);
+
+    class_addbang(latprobe_class, latprobe_bang);
+    class_addfloat(latprobe_class, latprobe_float);
+    class_addlist(latprobe_class, latprobe_list);
+    class_addanything(latprobe_class, latprobe_anything);
+
+    post("latprobe: latency probe ([latprobe stamp|mark|measure|report <probe> [stage]])");
+}
@@ -2,17 +2,30 @@
 //   'current <notes>' - Set current chord (COLD)
 //   'root <0-11>'     - Set root interval (COLD)
 //   'chord <ints>'    - Set target chord intervals (HOT - triggers calculation!)
+//   'mode exact|fast' - Minimum-cost or greedy voice assignment (reported on info)
+//   'metric l1|l2|linf|weighted [weights]'
+//                     - Distance to minimize; weights go bass first (reported on info)
+//   'range <low> <high> [span] [spacing] [doubling]'
+//                     - Nearest voicing within these rules instead of the
+//                       stable centroid; 'range' alone goes back
+//   'stats [reset]'   - 'stats engine <calls> <hits> <total ms> <max us> <p99 us>
+//                       <last cost>' on info, or clear the counters
 //
 // Outlets: [bass] [chord] [cost] [info]
 
 #include "m_pd.h"
+#include "voicelead.h"
+#include "vl_trace.h"
+#include "vl_stats.h"
 #include <stdlib.h>
 #include <string.h>
-#include <math.h>
 
-#define MAX_VOICES 8
+#define MAX_VOICES VL_MAX_VOICES
 #define STABLE_CENTROID 60.0f  // C4 - fixed register target
 
+#define MODE_EXACT 0   // Minimum total motion (subset DP)
+#define MODE_FAST 1    // Greedy nearest-unused, order dependent
+
 static t_class *orbifold_class;
 
 typedef struct _orbifold {
@@ -28,93 +41,53 @@ typedef struct _orbifold {
     int chord_intervals[MAX_VOICES];
     int chord_size;
     
+    int mode;
+    vl_metric_t metric;
+    int exhaustive;           // 'range' set
+    vl_voicing_rules_t rules;
     int feedback_enabled;
     int debug_enabled;
+    vl_trace_t trace;         // Debug records, posted by trace_clock
+    t_clock *trace_clock;
+    vl_stats_t stats;         // Calculations timed for 'stats'
 } t_orbifold;
 
-// Reduce chord to prime form (sorted PCs starting at 0)
-static void reduce_to_prime_form(int *chord, int size, int *prime) {
-    // Step 1: Convert to pitch classes
-    int pcs[MAX_VOICES];
-    for (int i = 0; i < size; i++) {
-        pcs[i] = chord[i] % 12;
-        if (pcs[i] < 0) pcs[i] += 12;
-    }
-    
-    // Step 2: Sort
-    for (int i = 0; i < size - 1; i++) {
-        for (int j = i + 1; j < size; j++) {
-            if (pcs[j] < pcs[i]) {
-                int temp = pcs[i];
-                pcs[i] = pcs[j];
-                pcs[j] = temp;
-            }
-        }
-    }
-    
-    // Step 3: Normalize to start at 0
-    int base = pcs[0];
-    for (int i = 0; i < size; i++) {
-        prime[i] = (pcs[i] - base + 12) % 12;
-    }
-}
+// Trace events and how the drain clock formats them; fractional values
+// travel as hundredths split into whole and fraction
+enum {
+    TRACE_START,
+    TRACE_INPUT,
+    TRACE_PRIME,
+    TRACE_TARGET,
+    TRACE_DISTANCE,
+    TRACE_OUTPUT,
+    TRACE_CENTROID,
+    TRACE_CURRENT_SET,
+    TRACE_ROOT_SET,
+    TRACE_CHORD_SET,
+    TRACE_RANGE
+};
 
-static int place_around_centroid(int pitch_class, float centroid) {
-    int best_note = 60;  // default to middle C
-    float min_distance = 10000.0f;
-    int base_octave = (int)(centroid / 12.0f);
-    
-    // Test octaves around stable centroid
-    for (int oct_offset = -2; oct_offset <= 2; oct_offset++) {
-        int octave = base_octave + oct_offset;
-        if (octave < 2 || octave > 6) continue;
-        
-        int candidate = octave * 12 + pitch_class;
-        float distance = fabs(candidate - centroid);
-        
-        if (distance < min_distance) {
-            min_distance = distance;
-            best_note = candidate;
-        }
-    }
-    
-    return best_note;
-}
+static const char *const trace_formats[] = {
+    [TRACE_START] = "=== ORBIFOLD (STABLE CENTROID) === Current: [%d %d %d %d]",
+    [TRACE_INPUT] = "Root: %d, Intervals: [%d %d %d %d]",
+    [TRACE_PRIME] = "Current prime form: [%d %d %d %d]",
+    [TRACE_TARGET] = "Target voicing (around C4=60): [%d %d %d %d]",
+    [TRACE_DISTANCE] = "Voice leading distance: %d.%02d semitones",
+    [TRACE_OUTPUT] = "Bass: %d, Output: [%d %d %d %d]",
+    [TRACE_CENTROID] = "Output centroid: %d.%02d (target was %d.%02d)",
+    [TRACE_CURRENT_SET] = "orbifold: current set to [%d %d %d %d]",
+    [TRACE_ROOT_SET] = "orbifold: root set to %d",
+    [TRACE_CHORD_SET] = "orbifold: chord set to [%d %d %d %d]",
+    [TRACE_RANGE] = "Exhaustive search: %d partial voicings"
+};
 
-// Calculate optimal mapping considering voice leading distances
-static float calculate_voice_leading(int *current, int current_size,
-                                     int *target, int target_size,
-                                     int *mapping) {
-    float total_distance = 0.0f;
-    int used[MAX_VOICES] = {0};
-    
-    // Greedy assignment: each current note finds closest unused target
-    for (int i = 0; i < current_size; i++) {
-        int best_j = -1;
-        float min_dist = 10000.0f;
-        
-        for (int j = 0; j < target_size; j++) {
-            if (used[j]) continue;
-            
-            // Calculate semitone distance
-            float dist = fabs(current[i] - target[j]);
-            
-            if (dist < min_dist) {
-                min_dist = dist;
-                best_j = j;
-            }
-        }
-        
-        if (best_j >= 0) {
-            mapping[i] = best_j;
-            used[best_j] = 1;
-            total_distance += min_dist;
-        } else {
-            mapping[i] = -1;
-        }
-    }
-    
-    return total_distance;
+#define TRACE(event, ...) VL_TRACE_EVENT(&x->trace, x->debug_enabled, event, __VA_ARGS__)
+#define HUNDREDTHS(value) ((int)((value) * 100 + 0.5f))
+
+// Reduce chord to prime form (its PC set transposed to start at 0)
+static pcset_t reduce_to_prime_form(int *chord, int size) {
+    return pcset_normalize(pcset_from_pitches(chord, size, 12), 12);
 }
 
 // Main calculation
@@ -124,83 +97,76 @@ static void orbifold_calculate(t_orbifold *x) {
         return;
     }
     
-    if (x->debug_enabled) {
-        post("\n=== ORBIFOLD (STABLE CENTROID) ===");
-        post("Current: [%d %d %d %d]", 
-             x->current_chord[0], x->current_chord[1],
-             x->current_chord[2], x->current_chord[3]);
-        post("Root: %d, Intervals: [%d %d %d %d]",
-             x->root_interval, x->chord_intervals[0], x->chord_intervals[1],
-             x->chord_intervals[2], x->chord_intervals[3]);
-    }
+    TRACE(TRACE_START, x->current_chord[0], x->current_chord[1],
+          x->current_chord[2], x->current_chord[3]);
+    TRACE(TRACE_INPUT, x->root_interval, x->chord_intervals[0], x->chord_intervals[1],
+          x->chord_intervals[2], x->chord_intervals[3]);
     
-    // STEP 1: Reduce current chord to prime form (for analysis)
-    int current_prime[MAX_VOICES];
-    reduce_to_prime_form(x->current_chord, x->current_size, current_prime);
+    unsigned long long start = vl_stats_now();
     
-    if (x->debug_enabled) {
-        post("Current prime form: [%d %d %d %d]",
-             current_prime[0], current_prime[1],
-             current_prime[2], current_prime[3]);
-    }
-    
-    // STEP 2: Build target pitch classes
-    int target_pc[MAX_VOICES];
-    for (int i = 0; i < x->chord_size; i++) {
-        target_pc[i] = (x->root_interval + x->chord_intervals[i]) % 12;
-        if (target_pc[i] < 0) target_pc[i] += 12;
-    }
+    // STEP 1: Reduce current chord to prime form (for analysis)
+    pcset_t current_prime = reduce_to_prime_form(x->current_chord, x->current_size);
     
     if (x->debug_enabled) {
-        post("Target PCs: [%d %d %d %d]",
-             target_pc[0], target_pc[1],
-             target_pc[2], target_pc[3]);
+        int prime_pcs[12];
+        int prime_size = pcset_members(current_prime, prime_pcs);
+        TRACE(TRACE_PRIME,
+              prime_size > 0 ? prime_pcs[0] : -1,
+              prime_size > 1 ? prime_pcs[1] : -1,
+              prime_size > 2 ? prime_pcs[2] : -1,
+              prime_size > 3 ? prime_pcs[3] : -1);
     }
     
-    // STEP 3: Place target PCs around STABLE centroid (not calculated from current!)
     int target_voicing[MAX_VOICES];
-    for (int i = 0; i < x->chord_size; i++) {
-        target_voicing[i] = place_around_centroid(target_pc[i], STABLE_CENTROID);
-    }
-    
-    // Sort for canonical ordering
-    for (int i = 0; i < x->chord_size - 1; i++) {
-        for (int j = i + 1; j < x->chord_size; j++) {
-            if (target_voicing[j] < target_voicing[i]) {
-                int temp = target_voicing[i];
-                target_voicing[i] = target_voicing[j];
-                target_voicing[j] = temp;
-            }
+    int mapping[MAX_VOICES];
+    float voice_leading_distance;
+    
+    if (x->exhaustive) {
+        // STEP 2-4 ('range'): nearest voicing in the rules, voices kept in rank order
+        int pcs[MAX_VOICES], voicing[MAX_VOICES];
+        long nodes;
+        for (int i = 0; i < x->chord_size; i++) {
+            pcs[i] = pc_mod(x->chord_intervals[i] + x->root_interval, 12);
         }
+        int cost = vl_voicing_nearest(&x->metric, &x->rules, pcs, x->chord_size, x->root_interval,
+                                      x->current_chord, x->current_size, voicing, &nodes);
+        TRACE(TRACE_RANGE, (int)nodes);
+        if (cost < 0) {
+            pd_error(x, "orbifold: no voicing of the chord fits the range");
+            return;
+        }
+        vl_voicing_by_rank(x->current_chord, x->current_size, voicing, target_voicing);
+        for (int i = 0; i < x->current_size; i++) {
+            mapping[i] = i;
+        }
+        voice_leading_distance = cost;
+    } else {
+        // STEP 2-3: Place target PCs around STABLE centroid (not calculated from current!)
+        vl_centroid_voicing(x->root_interval, x->chord_intervals, x->chord_size,
+                            STABLE_CENTROID, target_voicing);
+        
+        // STEP 4: Calculate voice mapping
+        voice_leading_distance = (x->mode == MODE_FAST)
+            ? vl_assign_greedy(&x->metric, x->current_chord, x->current_size,
+                               target_voicing, x->chord_size, mapping)
+            : vl_assign_exact(&x->metric, x->current_chord, x->current_size,
+                              target_voicing, x->chord_size, mapping);
     }
     
-    if (x->debug_enabled) {
-        post("Target voicing (around C4=60): [%d %d %d %d]",
-             target_voicing[0], target_voicing[1],
-             target_voicing[2], target_voicing[3]);
-    }
-    
-    // STEP 4: Calculate voice mapping
-    int mapping[MAX_VOICES];
-    float voice_leading_distance = calculate_voice_leading(
-        x->current_chord, x->current_size,
-        target_voicing, x->chord_size,
-        mapping
-    );
+    TRACE(TRACE_TARGET, target_voicing[0], target_voicing[1],
+          target_voicing[2], target_voicing[3]);
     
-    if (x->debug_enabled) {
-        post("Voice leading distance: %.2f semitones", voice_leading_distance);
-    }
+    TRACE(TRACE_DISTANCE, HUNDREDTHS(voice_leading_distance) / 100,
+          HUNDREDTHS(voice_leading_distance) % 100);
     
     // STEP 5: Create output chord
     t_atom output_chord[MAX_VOICES];
     int output[MAX_VOICES];
     
+    // A voice left without a target holds its note, as feedback keeps it
     for (int i = 0; i < x->current_size; i++) {
-        if (mapping[i] >= 0) {
-            output[i] = target_voicing[mapping[i]];
-            SETFLOAT(&output_chord[i], output[i]);
-        }
+        output[i] = mapping[i] >= 0 ? target_voicing[mapping[i]] : x->current_chord[i];
+        SETFLOAT(&output_chord[i], output[i]);
     }
     
     // STEP 6: Calculate bass (one octave below lowest voice)
@@ -216,8 +182,7 @@ static void orbifold_calculate(t_orbifold *x) {
     int bass_note = bass_octave * 12 + x->root_interval;
     
     if (x->debug_enabled) {
-        post("Bass: %d, Output: [%d %d %d %d]",
-             bass_note, output[0], output[1], output[2], output[3]);
+        TRACE(TRACE_OUTPUT, bass_note, output[0], output[1], output[2], output[3]);
         
         // Verify against stable centroid
         float actual_centroid = 0;
@@ -225,11 +190,13 @@ static void orbifold_calculate(t_orbifold *x) {
             actual_centroid += output[i];
         }
         actual_centroid /= x->current_size;
-        post("Output centroid: %.2f (target was %.2f)", 
-             actual_centroid, STABLE_CENTROID);
-        post("=== COMPLETE ===\n");
+        TRACE(TRACE_CENTROID, HUNDREDTHS(actual_centroid) / 100,
+              HUNDREDTHS(actual_centroid) % 100, HUNDREDTHS(STABLE_CENTROID) / 100,
+              HUNDREDTHS(STABLE_CENTROID) % 100);
     }
     
+    vl_stats_add(&x->stats, vl_stats_now() - start, 0, voice_leading_distance);
+    
     // Output (rightmost first)
     t_atom info[3];
     SETFLOAT(&info[0], STABLE_CENTROID);
@@ -263,22 +230,15 @@ static void orbifold_current(t_orbifold *x, t_symbol *s, int argc, t_atom *argv)
         x->current_chord[i] = (int)atom_getfloat(&argv[i]);
     }
     
-    if (x->debug_enabled) {
-        post("orbifold: current set to [%d %d %d %d]",
-             x->current_chord[0], x->current_chord[1],
-             x->current_chord[2], x->current_chord[3]);
-    }
+    TRACE(TRACE_CURRENT_SET, x->current_chord[0], x->current_chord[1],
+          x->current_chord[2], x->current_chord[3]);
 }
 
 // Set root interval (COLD)
 static void orbifold_root(t_orbifold *x, t_floatarg f) {
-    int root = (int)f % 12;
-    if (root < 0) root += 12;
-    x->root_interval = root;
+    x->root_interval = pc_mod((int)f, 12);
     
-    if (x->debug_enabled) {
-        post("orbifold: root set to %d", x->root_interval);
-    }
+    TRACE(TRACE_ROOT_SET, x->root_interval);
 }
 
 // Set chord intervals (HOT)
@@ -293,11 +253,8 @@ static void orbifold_chord(t_orbifold *x, t_symbol *s, int argc, t_atom *argv) {
         x->chord_intervals[i] = (int)atom_getfloat(&argv[i]);
     }
     
-    if (x->debug_enabled) {
-        post("orbifold: chord set to [%d %d %d %d]",
-             x->chord_intervals[0], x->chord_intervals[1],
-             x->chord_intervals[2], x->chord_intervals[3]);
-    }
+    TRACE(TRACE_CHORD_SET, x->chord_intervals[0], x->chord_intervals[1],
+          x->chord_intervals[2], x->chord_intervals[3]);
     
     if (x->current_size > 0) {
         orbifold_calculate(x);
@@ -306,16 +263,103 @@ static void orbifold_chord(t_orbifold *x, t_symbol *s, int argc, t_atom *argv) {
     }
 }
 
+// Select assignment mode; no argument just reports the current one
+static void orbifold_mode(t_orbifold *x, t_symbol *s) {
+    if (s == gensym("exact")) {
+        x->mode = MODE_EXACT;
+    } else if (s == gensym("fast")) {
+        x->mode = MODE_FAST;
+    } else if (s != &s_) {
+        pd_error(x, "orbifold: unknown mode '%s' (exact|fast)", s->s_name);
+        return;
+    }
+    
+    t_atom mode;
+    SETSYMBOL(&mode, gensym(x->mode == MODE_FAST ? "fast" : "exact"));
+    outlet_anything(x->x_out_info, gensym("mode"), 1, &mode);
+}
+
+// Select the distance metric; no argument just reports the current one
+static void orbifold_metric(t_orbifold *x, t_symbol *s, int argc, t_atom *argv) {
+    if (argc > 0) {
+        int weights[MAX_VOICES];
+        int count = argc - 1 < MAX_VOICES ? argc - 1 : MAX_VOICES;
+        for (int i = 0; i < count; i++) {
+            weights[i] = (int)atom_getfloat(&argv[i + 1]);
+        }
+        t_symbol *name = atom_getsymbol(&argv[0]);
+        if (vl_metric_set(&x->metric, name->s_name, weights, count) != 0) {
+            pd_error(x, "orbifold: bad metric '%s' (l1|l2|linf|weighted <weights >= 0>)",
+                     name->s_name);
+            return;
+        }
+    }
+    
+    // Weights only for the voices there are
+    t_atom info[1 + MAX_VOICES];
+    int count = x->metric.kind == VL_METRIC_WEIGHTED ? x->current_size : 0;
+    SETSYMBOL(&info[0], gensym(vl_metric_names[x->metric.kind]));
+    for (int i = 0; i < count; i++) {
+        SETFLOAT(&info[i + 1], x->metric.weights[i]);
+    }
+    outlet_anything(x->x_out_info, gensym("metric"), count + 1, info);
+}
+
+// Voicing rules for the exhaustive search (defaults fill missing values);
+// no arguments returns to the stable centroid
+static void orbifold_range(t_orbifold *x, t_symbol *s, int argc, t_atom *argv) {
+    if (argc == 0) {
+        x->exhaustive = 0;
+        post("orbifold: stable centroid voicings");
+        return;
+    }
+    
+    int values[5];
+    int count = argc < 5 ? argc : 5;
+    for (int i = 0; i < count; i++) {
+        values[i] = (int)atom_getfloat(&argv[i]);
+    }
+    
+    vl_voicing_rules_t rules;
+    vl_voicing_rules_default(&rules);
+    if (vl_voicing_rules_set(&rules, values, count) != 0) {
+        pd_error(x, "orbifold: bad range (low < high, span and spacing >= 0, doubling 0-2)");
+        return;
+    }
+    x->rules = rules;
+    x->exhaustive = 1;
+    post("orbifold: voicings %d-%d, span %d, spacing %d, doubling %d",
+         rules.low, rules.high, rules.max_span, rules.min_spacing, rules.doubling);
+}
+
+// Calculation count and times; 'stats reset' clears them
+static void orbifold_stats(t_orbifold *x, t_symbol *s, int argc, t_atom *argv) {
+    if (argc > 0 && atom_getsymbol(&argv[0]) == gensym("reset")) {
+        vl_stats_reset(&x->stats);
+        post("orbifold: stats reset");
+        return;
+    }
+    vl_stats_output(&x->stats, x->x_out_info);
+}
+
 // Toggle feedback
 static void orbifold_feedback(t_orbifold *x, t_floatarg f) {
     x->feedback_enabled = (f != 0);
     post("orbifold: feedback %s", x->feedback_enabled ? "enabled" : "disabled");
 }
 
+// Post queued trace records; keeps ticking while debug is on or records remain
+static void orbifold_trace_tick(t_orbifold *x) {
+    if (vl_trace_drain(&x->trace, trace_formats, "orbifold") || x->debug_enabled) {
+        clock_delay(x->trace_clock, VL_TRACE_DRAIN_MS);
+    }
+}
+
 // Toggle debug
 static void orbifold_debug(t_orbifold *x, t_floatarg f) {
     x->debug_enabled = (f != 0);
     post("orbifold: debug %s", x->debug_enabled ? "enabled" : "disabled");
+    if (x->debug_enabled) clock_delay(x->trace_clock, VL_TRACE_DRAIN_MS);
 }
 
 // Bang
@@ -335,8 +379,15 @@ static void *orbifold_new(void) {
     x->current_size = 0;
     x->chord_size = 0;
     x->root_interval = 0;
+    x->mode = MODE_EXACT;
+    vl_metric_default(&x->metric);
+    x->exhaustive = 0;
+    vl_voicing_rules_default(&x->rules);
     x->feedback_enabled = 1;
     x->debug_enabled = 0;
+    vl_trace_init(&x->trace);
+    x->trace_clock = clock_new(x, (t_method)orbifold_trace_tick);
+    vl_stats_reset(&x->stats);
     
     // Default C major
     x->current_chord[0] = 48;
@@ -351,10 +402,15 @@ static void *orbifold_new(void) {
     return (void *)x;
 }
 
+// Destructor
+static void orbifold_free(t_orbifold *x) {
+    clock_free(x->trace_clock);
+}
+
 void orbifold_setup(void) {
     orbifold_class = class_new(gensym("orbifold"),
                                (t_newmethod)orbifold_new,
-                               0,
+                               (t_method)orbifold_free,
                                sizeof(t_orbifold),
                                CLASS_DEFAULT,
                                0);
@@ -365,6 +421,14 @@ void orbifold_setup(void) {
                    gensym("root"), A_FLOAT, 0);
     class_addmethod(orbifold_class, (t_method)orbifold_chord,
                    gensym("chord"), A_GIMME, 0);
+    class_addmethod(orbifold_class, (t_method)orbifold_mode,
+                   gensym("mode"), A_DEFSYM, 0);
+    class_addmethod(orbifold_class, (t_method)orbifold_metric,
+                   gensym("metric"), A_GIMME, 0);
+    class_addmethod(orbifold_class, (t_method)orbifold_range,
+                   gensym("range"), A_GIMME, 0);
+    class_addmethod(orbifold_class, (t_method)orbifold_stats,
+                   gensym("stats"), A_GIMME, 0);
     class_addmethod(orbifold_class, (t_method)orbifold_feedback,
                    gensym("feedback"), A_FLOAT, 0);
     class_addmethod(orbifold_class, (t_method)orbifold_debug,
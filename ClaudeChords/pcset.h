@@ -0,0 +1,93 @@
+// Pitch-class sets as bitmasks, shared by the ClaudeChords externals
+//
+// Bit p is set when pitch class p is present, so building a set from a
+// chord dedups for free (OR), membership is a shift, transposition is a
+// rotation and the members come out already sorted (ctz iteration).
+// Every function takes the modulus, so nothing here assumes 12-EDO.
+
+#ifndef PCSET_H
+#define PCSET_H
+
+#include <stdint.h>
+
+// 64 bits: wide enough for 31-EDO and beyond
+typedef uint64_t pcset_t;
+
+#define PCSET_MAX_MODULUS 64
+
+// Pitch class of any integer pitch (also for negative pitches)
+static inline int pc_mod(int pitch, int modulus) {
+    int pc = pitch % modulus;
+    return pc < 0 ? pc + modulus : pc;
+}
+
+static inline pcset_t pcset_full(int modulus) {
+    return modulus >= PCSET_MAX_MODULUS ? ~(pcset_t)0 : ((pcset_t)1 << modulus) - 1;
+}
+
+static inline pcset_t pcset_from_pitches(const int *pitches, int size, int modulus) {
+    pcset_t set = 0;
+    for (int i = 0; i < size; i++) {
+        set |= (pcset_t)1 << pc_mod(pitches[i], modulus);
+    }
+    return set;
+}
+
+static inline int pcset_contains(pcset_t set, int pc) {
+    return (set >> pc) & 1;
+}
+
+static inline int pcset_size(pcset_t set) {
+    return __builtin_popcountll(set);
+}
+
+// Lowest pitch class in a non-empty set
+static inline int pcset_lowest(pcset_t set) {
+    return __builtin_ctzll(set);
+}
+
+// Members in ascending order; returns the count
+static inline int pcset_members(pcset_t set, int *pcs) {
+    int size = 0;
+    while (set) {
+        pcs[size++] = __builtin_ctzll(set);
+        set &= set - 1;
+    }
+    return size;
+}
+
+// T_n of a set (0 <= n < modulus)
+static inline pcset_t pcset_transpose(pcset_t set, int n, int modulus) {
+    if (n == 0) return set;
+    return ((set << n) | (set >> (modulus - n))) & pcset_full(modulus);
+}
+
+// Transposed so the lowest pitch class is 0
+static inline pcset_t pcset_normalize(pcset_t set, int modulus) {
+    return set ? pcset_transpose(set, modulus - pcset_lowest(set), modulus) : 0;
+}
+
+// Transposition-normalized form of a (source, target) pair: the T_-shift
+// giving the smallest source set, ties broken by the smallest target set.
+// Both sets move together, so source -> target is
+// canonical_source -> canonical_target shifted up by shift.
+static inline void pcset_canonical_pair(pcset_t source, pcset_t target, int modulus,
+                                        pcset_t *canonical_source,
+                                        pcset_t *canonical_target,
+                                        int *shift) {
+    *canonical_source = source;
+    *canonical_target = target;
+    *shift = 0;
+    for (int n = 1; n < modulus; n++) {
+        pcset_t s = pcset_transpose(source, modulus - n, modulus);
+        pcset_t t = pcset_transpose(target, modulus - n, modulus);
+        if (s < *canonical_source ||
+            (s == *canonical_source && t < *canonical_target)) {
+            *canonical_source = s;
+            *canonical_target = t;
+            *shift = n;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,126 @@
+// Logs an engine's input for vl_replay (see vl_record.h)
+//
+// Message routing:
+//   'open <file.vlrec>' - Start a log (path relative to the patch); replaces
+//                         one already open
+//   'close'             - Finish it
+//   anything else       - Passed through unchanged; 'current', 'root',
+//                         'chord', 'target' and 'feedback' are logged first
+//   right inlet: list   - The chord the engine sent back, logged for vl_replay
+//                         to check against
+//
+// Creation argument: the engine it feeds, voice_leading (default),
+// orbifold or hungarian.
+//
+// Outlets: [passed through]
+
+#include "m_pd.h"
+#include "vl_record.h"
+#include <stdio.h>
+
+static t_class *recorder_class;
+
+typedef struct _recorder {
+    t_object x_obj;
+    t_outlet *x_out;
+
+    t_canvas *canvas;         // For relative paths
+    t_symbol *engine;
+    vl_record_t record;
+    double start;             // Logical time of 'open'
+} t_recorder;
+
+static void recorder_log(t_recorder *x, int kind, int argc, t_atom *argv) {
+    if (!x->record.file) return;
+
+    int values[VL_RECORD_MAX_VALUES];
+    int count = argc < VL_RECORD_MAX_VALUES ? argc : VL_RECORD_MAX_VALUES;
+    for (int i = 0; i < count; i++) {
+        values[i] = (int)atom_getfloat(&argv[i]);
+    }
+    unsigned int time = (unsigned int)clock_gettimesince(x->start);
+    if (vl_record_write(&x->record, time, kind, values, count) != 0) {
+        pd_error(x, "recorder: write failed, log closed after %lu events",
+                 x->record.events);
+        vl_record_close(&x->record);
+    }
+}
+
+static void recorder_close(t_recorder *x) {
+    if (!x->record.file) return;
+    post("recorder: %lu events logged", x->record.events);
+    vl_record_close(&x->record);
+}
+
+static void recorder_open(t_recorder *x, t_symbol *s) {
+    char path[MAXPDSTRING];
+    if (s->s_name[0] == '/') {
+        snprintf(path, sizeof(path), "%s", s->s_name);
+    } else {
+        snprintf(path, sizeof(path), "%s/%s", canvas_getdir(x->canvas)->s_name, s->s_name);
+    }
+
+    recorder_close(x);
+    if (vl_record_create(&x->record, path, x->engine->s_name) != 0) {
+        pd_error(x, "recorder: can't write %s", path);
+        return;
+    }
+    x->start = clock_getlogicaltime();
+    post("recorder: logging %s input to %s", x->engine->s_name, path);
+}
+
+// Engine input: log the five engine messages, pass everything on
+static void recorder_anything(t_recorder *x, t_symbol *s, int argc, t_atom *argv) {
+    int kind = vl_record_kind(s->s_name);
+    if (kind >= 0 && kind != VL_RECORD_OUTPUT) recorder_log(x, kind, argc, argv);
+    outlet_anything(x->x_out, s, argc, argv);
+}
+
+// Right inlet: the engine's chord outlet
+static void recorder_output(t_recorder *x, t_symbol *s, int argc, t_atom *argv) {
+    recorder_log(x, VL_RECORD_OUTPUT, argc, argv);
+}
+
+static void *recorder_new(t_symbol *engine) {
+    if (engine == &s_) engine = gensym("voice_leading");
+    if (engine != gensym("voice_leading") && engine != gensym("orbifold") &&
+        engine != gensym("hungarian")) {
+        pd_error(0, "recorder: engine is voice_leading|orbifold|hungarian, not '%s'",
+                 engine->s_name);
+        return NULL;
+    }
+
+    t_recorder *x = (t_recorder *)pd_new(recorder_class);
+    inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_list, gensym("output"));
+    x->x_out = outlet_new(&x->x_obj, 0);
+
+    x->canvas = canvas_getcurrent();
+    x->engine = engine;
+    x->record.file = NULL;
+    x->start = 0;
+
+    return (void *)x;
+}
+
+static void recorder_free(t_recorder *x) {
+    recorder_close(x);
+}
+
+void recorder_setup(void) {
+    recorder_class = class_new(gensym("recorder"),
+                               (t_newmethod)(t_method)recorder_new,
+                               (t_method)recorder_free,
+                               sizeof(t_recorder),
+                               CLASS_DEFAULT,
+                               A_DEFSYM, 0);
+
+    class_addmethod(recorder_class, (t_method)recorder_open,
+                    gensym("open"), A_SYMBOL, 0);
+    class_addmethod(recorder_class, (t_method)recorder_close,
+                    gensym("close"), 0);
+    class_addmethod(recorder_class, (t_method)recorder_output,
+                    gensym("output"), A_GIMME, 0);
+    class_addanything(recorder_class, recorder_anything);
+
+    post("recorder: engine input logger ('open <file.vlrec>', 'close'; replay with vl_replay)");
+}
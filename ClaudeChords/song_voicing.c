@@ -0,0 +1,137 @@
+// Plays back a song's precompiled voicings (see vl_sidecar.h)
+//
+// Message routing:
+//   'open <song.txt>' - Map the song's .vlsong sidecar (path relative to the patch)
+//   <bar>             - Output bar bN's voicing, bass and cost (no computation)
+//   'close'           - Unmap
+//   'stats [reset]'   - Lookup count and times on info (every bar counts as a
+//                       hit: it was precompiled), or clear them
+//
+// Outlets: [chord] [bass] [cost] [info]
+// info: 'song <bars> <voices> <total cost>' after a successful open
+
+#include "m_pd.h"
+#include "vl_sidecar.h"
+#include "vl_stats.h"
+#include <stdio.h>
+
+static t_class *song_voicing_class;
+
+typedef struct _song_voicing {
+    t_object x_obj;
+    t_outlet *x_out_chord;
+    t_outlet *x_out_bass;
+    t_outlet *x_out_cost;
+    t_outlet *x_out_info;
+
+    t_canvas *canvas;         // For relative paths
+    vl_sidecar_t sidecar;
+    vl_stats_t stats;         // Bar lookups timed for 'stats'
+} t_song_voicing;
+
+// Map a song's sidecar; a missing or stale one leaves nothing mapped
+static void song_voicing_open(t_song_voicing *x, t_symbol *s) {
+    char path[MAXPDSTRING];
+    if (s->s_name[0] == '/') {
+        snprintf(path, sizeof(path), "%s", s->s_name);
+    } else {
+        snprintf(path, sizeof(path), "%s/%s", canvas_getdir(x->canvas)->s_name, s->s_name);
+    }
+
+    vl_sidecar_close(&x->sidecar);
+    int status = vl_sidecar_open(&x->sidecar, path);
+    if (status == VL_SIDECAR_MISSING) {
+        pd_error(x, "song_voicing: no sidecar for %s (build it with 'make songs')", path);
+        return;
+    }
+    if (status == VL_SIDECAR_STALE) {
+        pd_error(x, "song_voicing: sidecar for %s is stale (rebuild with 'make songs')", path);
+        return;
+    }
+
+    t_atom info[3];
+    SETFLOAT(&info[0], x->sidecar.header->bar_count);
+    SETFLOAT(&info[1], x->sidecar.header->voices);
+    SETFLOAT(&info[2], x->sidecar.header->total_cost);
+    outlet_anything(x->x_out_info, gensym("song"), 3, info);
+}
+
+static void song_voicing_close(t_song_voicing *x) {
+    vl_sidecar_close(&x->sidecar);
+}
+
+// Output bar N (rightmost first)
+static void song_voicing_float(t_song_voicing *x, t_floatarg f) {
+    if (!x->sidecar.header) {
+        pd_error(x, "song_voicing: no song open");
+        return;
+    }
+
+    unsigned long long start = vl_stats_now();
+    const vl_sidecar_bar_t *bar = vl_sidecar_bar(&x->sidecar, (int)f);
+    if (!bar) {
+        pd_error(x, "song_voicing: no chord at bar %d", (int)f);
+        return;
+    }
+
+    t_atom chord[VL_MAX_VOICES];
+    for (int v = 0; v < bar->voices; v++) {
+        SETFLOAT(&chord[v], bar->notes[v]);
+    }
+    vl_stats_add(&x->stats, vl_stats_now() - start, 1, bar->cost);
+
+    outlet_float(x->x_out_cost, bar->cost);
+    outlet_float(x->x_out_bass, bar->bass);
+    outlet_list(x->x_out_chord, &s_list, bar->voices, chord);
+}
+
+// Lookup count and times; 'stats reset' clears them
+static void song_voicing_stats(t_song_voicing *x, t_symbol *s, int argc, t_atom *argv) {
+    if (argc > 0 && atom_getsymbol(&argv[0]) == gensym("reset")) {
+        vl_stats_reset(&x->stats);
+        post("song_voicing: stats reset");
+        return;
+    }
+    vl_stats_output(&x->stats, x->x_out_info);
+}
+
+// Constructor
+static void *song_voicing_new(void) {
+    t_song_voicing *x = (t_song_voicing *)pd_new(song_voicing_class);
+
+    x->x_out_chord = outlet_new(&x->x_obj, &s_list);
+    x->x_out_bass = outlet_new(&x->x_obj, &s_float);
+    x->x_out_cost = outlet_new(&x->x_obj, &s_float);
+    x->x_out_info = outlet_new(&x->x_obj, &s_list);
+
+    x->canvas = canvas_getcurrent();
+    x->sidecar.header = NULL;
+    x->sidecar.map = NULL;
+    vl_stats_reset(&x->stats);
+
+    return (void *)x;
+}
+
+// Destructor
+static void song_voicing_free(t_song_voicing *x) {
+    vl_sidecar_close(&x->sidecar);
+}
+
+void song_voicing_setup(void) {
+    song_voicing_class = class_new(gensym("song_voicing"),
+                                   (t_newmethod)song_voicing_new,
+                                   (t_method)song_voicing_free,
+                                   sizeof(t_song_voicing),
+                                   CLASS_DEFAULT,
+                                   0);
+
+    class_addmethod(song_voicing_class, (t_method)song_voicing_open,
+                    gensym("open"), A_SYMBOL, 0);
+    class_addmethod(song_voicing_class, (t_method)song_voicing_close,
+                    gensym("close"), 0);
+    class_addmethod(song_voicing_class, (t_method)song_voicing_stats,
+                    gensym("stats"), A_GIMME, 0);
+    class_addfloat(song_voicing_class, song_voicing_float);
+
+    post("song_voicing: precompiled song voicings ('open <song.txt>', then bar numbers)");
+}
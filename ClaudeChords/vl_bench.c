@@ -0,0 +1,575 @@
+// vl_bench - replays the song corpus through every voice-leading engine
+//
+// Usage: vl_bench [-n iterations] [-t table] <songs dir> <chords.txt>
+//
+// Every song progression (and chords.txt as one more progression) is fed
+// through each engine exactly as its external would run it with feedback
+// on, starting from C major (48 52 55 60), iterations times over. Each
+// call is timed with CLOCK_MONOTONIC. Prints JSON on stdout:
+//   engines[]:     ns/call p50/p99/max and the total voice motion
+//   differences[]: per engine pair, how many chords came out as another
+//                  voicing or another pitch-class set
+//   simd:          the vector level in use and, per level and metric, the
+//                  rotation costs of random 12- and 31-EDO PC-set pairs
+//                  against the scalar path (mismatches must be 0), ns per pair
+//   cyclic[]:      per metric, vl_dp_cyclic against one plain DP per
+//                  rotation on the pairs with targets of VL_CYCLIC_MIN PCs
+//                  and up (mismatches must be 0), ns per pair for both
+//   voicings[]:    per voice count (6-8), vl_voicing_nearest on every
+//                  corpus chord from a random current voicing (default
+//                  rules, any tone doubled), against
+//                  the cheapest of vl_voicings_enumerate (mismatches must
+//                  be 0): ns/call p50/p99/max, nodes and voicings per chord
+// Motion is the distance between consecutive voicings with both sorted,
+// i.e. the smallest bijective motion on the pitch line.
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "voicelead.h"
+#include "vl_simd.h"
+#include "vl_song.h"
+
+#define MAX_PROGRESSIONS 64
+#define SIMD_PAIRS 20000   // Random set pairs per SIMD check
+#define VOICINGS_MIN 6     // Voice counts the voicing check runs
+#define VOICINGS_MAX VL_MAX_VOICES
+
+typedef struct _engine_state {
+    int current[VL_MAX_VOICES];
+    int size;
+    vl_scratch_t scratch;
+    vl_context_t ctx;
+} engine_state_t;
+
+typedef struct _engine {
+    const char *name;
+    void (*step)(engine_state_t *state, const vl_chord_t *chord,
+                 int *output, int *output_size);
+    engine_state_t state;
+    unsigned long *samples;   // ns per call
+    long sample_count;
+    long motion;
+    int (*outputs)[VL_MAX_VOICES];   // First pass, for the differences
+    int *output_sizes;
+} engine_t;
+
+static vl_song_t progressions[MAX_PROGRESSIONS];
+static int progression_count;
+static vl_table_t table;
+static vl_cache_t cache;
+static vl_modulus_t modulus;   // 12-EDO, as the corpus
+static vl_arena_t arena;       // Every scratch below
+static vl_scratch_t simd_scratch;
+
+static void target_pcs(const vl_chord_t *chord, int *pcs) {
+    for (int i = 0; i < chord->size; i++) {
+        pcs[i] = pc_mod(chord->root + chord->intervals[i], VL_MODULUS);
+    }
+}
+
+static void step_voice_leading(engine_state_t *s, const vl_chord_t *chord,
+                               int *output, int *output_size) {
+    int pcs[VL_MAX_VOICES];
+    vl_pair_t vl[VL_MAX_PAIRS];
+    int vl_size;
+    target_pcs(chord, pcs);
+    vl_nonbijective(&s->ctx, s->current, s->size, pcs, chord->size, vl, &vl_size);
+    *output_size = vl_apply(&modulus, s->current, s->size, vl, vl_size, output);
+}
+
+static void step_orbifold(engine_state_t *s, const vl_chord_t *chord,
+                          int *output, int *output_size, int exact) {
+    int voicing[VL_MAX_VOICES];
+    int mapping[VL_MAX_VOICES];
+    vl_centroid_voicing(chord->root, chord->intervals, chord->size, 60.0f, voicing);
+    if (exact) vl_assign_exact(NULL, s->current, s->size, voicing, chord->size, mapping);
+    else vl_assign_greedy(NULL, s->current, s->size, voicing, chord->size, mapping);
+
+    // Unassigned voices hold, as the external's feedback does
+    for (int i = 0; i < s->size; i++) {
+        output[i] = mapping[i] >= 0 ? voicing[mapping[i]] : s->current[i];
+    }
+    *output_size = s->size;
+}
+
+static void step_orbifold_exact(engine_state_t *s, const vl_chord_t *chord,
+                                int *output, int *output_size) {
+    step_orbifold(s, chord, output, output_size, 1);
+}
+
+static void step_orbifold_fast(engine_state_t *s, const vl_chord_t *chord,
+                               int *output, int *output_size) {
+    step_orbifold(s, chord, output, output_size, 0);
+}
+
+static void step_hungarian(engine_state_t *s, const vl_chord_t *chord,
+                           int *output, int *output_size) {
+    int pcs[VL_MAX_VOICES];
+    int notes[VL_MAX_VARIANTS];
+    int count, anchor;
+    int assignment[VL_MAX_VOICES];
+    target_pcs(chord, pcs);
+    vl_hungarian(NULL, s->current, s->size, pcs, chord->size, notes, &count, &anchor,
+                 assignment);
+
+    for (int i = 0; i < s->size; i++) {
+        output[i] = assignment[i] >= 0 ? notes[assignment[i]] : s->current[i];
+    }
+    *output_size = s->size;
+}
+
+static engine_t engines[] = {
+    { .name = "voice_leading", .step = step_voice_leading },
+    { .name = "voice_leading_live", .step = step_voice_leading },
+    { .name = "orbifold_exact", .step = step_orbifold_exact },
+    { .name = "orbifold_fast", .step = step_orbifold_fast },
+    { .name = "hungarian", .step = step_hungarian },
+};
+#define ENGINE_COUNT ((int)(sizeof(engines) / sizeof(engines[0])))
+
+static int compare_ints(const void *a, const void *b) {
+    return (*(const int *)a > *(const int *)b) - (*(const int *)a < *(const int *)b);
+}
+
+static int compare_ulongs(const void *a, const void *b) {
+    unsigned long x = *(const unsigned long *)a, y = *(const unsigned long *)b;
+    return (x > y) - (x < y);
+}
+
+static void sorted_copy(const int *chord, int size, int *sorted) {
+    memcpy(sorted, chord, size * sizeof(int));
+    qsort(sorted, size, sizeof(int), compare_ints);
+}
+
+static int sorted_distance(const int *a, int a_size, const int *b, int b_size) {
+    int sa[VL_MAX_VOICES], sb[VL_MAX_VOICES];
+    sorted_copy(a, a_size, sa);
+    sorted_copy(b, b_size, sb);
+    int distance = 0;
+    for (int i = 0; i < a_size && i < b_size; i++) {
+        distance += abs(sa[i] - sb[i]);
+    }
+    return distance;
+}
+
+static unsigned long elapsed_ns(const struct timespec *start, const struct timespec *end) {
+    return (unsigned long)(end->tv_sec - start->tv_sec) * 1000000000ul +
+           (unsigned long)(end->tv_nsec - start->tv_nsec);
+}
+
+static void run_engine(engine_t *e, int iterations) {
+    static const int start_chord[4] = { 48, 52, 55, 60 };
+    long step_index = 0;
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        step_index = 0;
+        for (int p = 0; p < progression_count; p++) {
+            memcpy(e->state.current, start_chord, sizeof(start_chord));
+            e->state.size = 4;
+
+            for (int c = 0; c < progressions[p].count; c++) {
+                int output[VL_MAX_VOICES];
+                int output_size;
+                struct timespec start, end;
+
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                e->step(&e->state, &progressions[p].chords[c], output, &output_size);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                e->samples[e->sample_count++] = elapsed_ns(&start, &end);
+
+                if (iteration == 0) {
+                    e->motion += sorted_distance(e->state.current, e->state.size,
+                                                 output, output_size);
+                    memcpy(e->outputs[step_index], output, output_size * sizeof(int));
+                    e->output_sizes[step_index] = output_size;
+                }
+                step_index++;
+
+                memcpy(e->state.current, output, output_size * sizeof(int));
+                e->state.size = output_size;
+            }
+        }
+    }
+}
+
+static int load_corpus(const char *songs_dir, const char *chords_path) {
+    DIR *dir = opendir(songs_dir);
+    if (!dir) {
+        perror(songs_dir);
+        return -1;
+    }
+
+    // Sorted names so the step order (and the JSON) is reproducible
+    char names[MAX_PROGRESSIONS][256];
+    int name_count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) && name_count < MAX_PROGRESSIONS - 1) {
+        size_t length = strlen(entry->d_name);
+        if (length > 4 && strcmp(entry->d_name + length - 4, ".txt") == 0) {
+            snprintf(names[name_count++], sizeof(names[0]), "%s", entry->d_name);
+        }
+    }
+    closedir(dir);
+    qsort(names, name_count, sizeof(names[0]), (int (*)(const void *, const void *))strcmp);
+
+    for (int i = 0; i < name_count; i++) {
+        char path[1024];
+        if (snprintf(path, sizeof(path), "%s/%s", songs_dir, names[i]) >= (int)sizeof(path)) {
+            continue;
+        }
+        if (vl_song_load(path, &progressions[progression_count]) == 0 &&
+            progressions[progression_count].count > 0) {
+            progression_count++;
+        }
+    }
+
+    if (vl_chord_list_load(chords_path, &progressions[progression_count]) != 0) {
+        perror(chords_path);
+        return -1;
+    }
+    if (progressions[progression_count].count > 0) progression_count++;
+    return 0;
+}
+
+static void print_differences(int steps) {
+    int first = 1;
+    printf("  \"differences\": [");
+    for (int a = 0; a < ENGINE_COUNT; a++) {
+        for (int b = a + 1; b < ENGINE_COUNT; b++) {
+            int voicings = 0, pitch_classes = 0;
+            for (int s = 0; s < steps; s++) {
+                int sa[VL_MAX_VOICES], sb[VL_MAX_VOICES];
+                int na = engines[a].output_sizes[s], nb = engines[b].output_sizes[s];
+                sorted_copy(engines[a].outputs[s], na, sa);
+                sorted_copy(engines[b].outputs[s], nb, sb);
+                if (na != nb || memcmp(sa, sb, na * sizeof(int)) != 0) voicings++;
+                if (pcset_from_pitches(sa, na, VL_MODULUS) !=
+                    pcset_from_pitches(sb, nb, VL_MODULUS)) pitch_classes++;
+            }
+            printf("%s\n    {\"a\": \"%s\", \"b\": \"%s\", \"voicings\": %d, "
+                   "\"pitch_classes\": %d, \"of\": %d}",
+                   first ? "" : ",", engines[a].name, engines[b].name,
+                   voicings, pitch_classes, steps);
+            first = 0;
+        }
+    }
+    printf("\n  ]\n");
+}
+
+// One random pair of sorted PC sets for the SIMD checks, plus a target
+// the size of the source for the bijective costs
+typedef struct _simd_pair {
+    int source[VL_MAX_SIZE];
+    int source_size;
+    int target[VL_MAX_SIZE];
+    int target_size;
+    int bijective[VL_MAX_SIZE];
+} simd_pair_t;
+
+static simd_pair_t simd_pairs[SIMD_PAIRS];
+
+// size random distinct PCs of n-EDO, sorted
+static void random_pcs(unsigned int *rng, int n, int size, int *pcs) {
+    pcset_t set = 0;
+    while (pcset_size(set) < size) {
+        set |= (pcset_t)1 << vl_random(rng) % n;
+    }
+    pcset_members(set, pcs);
+}
+
+static void simd_generate(int n) {
+    unsigned int rng = 12345;
+    int largest = n < VL_MAX_SIZE ? n : VL_MAX_SIZE;
+    for (int p = 0; p < SIMD_PAIRS; p++) {
+        simd_pair_t *pair = &simd_pairs[p];
+        pair->source_size = 1 + vl_random(&rng) % largest;
+        pair->target_size = 1 + vl_random(&rng) % largest;
+        random_pcs(&rng, n, pair->source_size, pair->source);
+        random_pcs(&rng, n, pair->target_size, pair->target);
+        random_pcs(&rng, n, pair->source_size, pair->bijective);
+    }
+}
+
+// Rotation costs of every pair at one level; returns the mismatches
+// against expected (filled instead when fill is set)
+static long simd_pass(int level, int metric, const vl_modulus_t *m,
+                      int (*expected)[VL_MAX_SIZE], int fill, unsigned long *ns) {
+    static int costs[SIMD_PAIRS][VL_MAX_SIZE];
+    long mismatches = 0;
+    struct timespec start, end;
+
+    vl_simd_force(level);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int p = 0; p < SIMD_PAIRS; p++) {
+        const simd_pair_t *pair = &simd_pairs[p];
+        if (metric < 0) {
+            vl_bijective_rotations(m, pair->source, pair->bijective, pair->source_size,
+                                   costs[p]);
+        } else {
+            vl_dp_rotations(&simd_scratch, metric, m, pair->source, pair->source_size,
+                            pair->target, pair->target_size, costs[p]);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *ns = elapsed_ns(&start, &end) / SIMD_PAIRS;
+
+    for (int p = 0; p < SIMD_PAIRS; p++) {
+        size_t bytes = (metric < 0 ? simd_pairs[p].source_size : simd_pairs[p].target_size) *
+                       sizeof(int);
+        if (fill) memcpy(expected[p], costs[p], bytes);
+        else if (memcmp(expected[p], costs[p], bytes) != 0) mismatches++;
+    }
+    return mismatches;
+}
+
+// Every available level against VL_SIMD_SCALAR, bit for bit, in 12- and
+// 31-EDO; the automatic level is restored afterwards
+static void print_simd(void) {
+    static int expected[SIMD_PAIRS][VL_MAX_SIZE];
+    static const char *const metrics[] = { "l1", "l2", "linf", "bijective" };
+    static const int metric_kinds[] = { VL_METRIC_L1, VL_METRIC_L2, VL_METRIC_LINF, -1 };
+    static const int moduli[] = { 12, 31 };
+    int automatic = vl_simd_level();
+    int first = 1;
+
+    printf("  \"simd\": {\"level\": \"%s\", \"checks\": [", vl_simd_names[automatic]);
+    for (int k = 0; k < 2; k++) {
+        vl_modulus_t m;
+        vl_modulus_init(&m, moduli[k]);
+        simd_generate(moduli[k]);
+        for (int metric = 0; metric < 4; metric++) {
+            unsigned long ns;
+            simd_pass(VL_SIMD_SCALAR, metric_kinds[metric], &m, expected, 1, &ns);
+            for (int level = 0; level < VL_SIMD_LEVELS; level++) {
+                if (!vl_simd_available(level)) continue;
+                long mismatches = simd_pass(level, metric_kinds[metric], &m, expected, 0, &ns);
+                printf("%s\n    {\"level\": \"%s\", \"modulus\": %d, \"metric\": \"%s\", "
+                       "\"pairs\": %d, \"mismatches\": %ld, \"ns\": %lu}",
+                       first ? "" : ",", vl_simd_names[level], moduli[k], metrics[metric],
+                       SIMD_PAIRS, mismatches, ns);
+                first = 0;
+            }
+        }
+    }
+    printf("\n  ]},\n");
+    vl_simd_force(automatic);
+}
+
+// vl_dp_cyclic against one plain DP per rotation, on the pairs with
+// targets big enough for vl_dp_rotations to take it
+static void print_cyclic(void) {
+    static int expected[SIMD_PAIRS][VL_MAX_SIZE];
+    static int costs[SIMD_PAIRS][VL_MAX_SIZE];
+    static const int moduli[] = { 12, 31 };
+    int first = 1;
+
+    printf("  \"cyclic\": [");
+    for (int k = 0; k < 2; k++) {
+        vl_modulus_t m;
+        vl_modulus_init(&m, moduli[k]);
+        simd_generate(moduli[k]);
+        for (int metric = VL_METRIC_L1; metric <= VL_METRIC_L2; metric++) {
+            struct timespec start, end;
+            int rotated[VL_MAX_SIZE];
+            long mismatches = 0;
+            int pairs = 0;
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (int p = 0; p < SIMD_PAIRS; p++) {
+                const simd_pair_t *pair = &simd_pairs[p];
+                int n = pair->target_size;
+                if (n < VL_CYCLIC_MIN) continue;
+                pairs++;
+                for (int r = 0; r < n; r++) {
+                    for (int i = 0; i < n; i++) rotated[i] = pair->target[(i + r) % n];
+                    expected[p][r] = vl_dp_cost(&simd_scratch, metric, &m,
+                                                pair->source, pair->source_size, rotated, n);
+                }
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            if (pairs == 0) continue;   // 12-EDO never gets there
+            unsigned long plain_ns = elapsed_ns(&start, &end) / pairs;
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (int p = 0; p < SIMD_PAIRS; p++) {
+                const simd_pair_t *pair = &simd_pairs[p];
+                if (pair->target_size < VL_CYCLIC_MIN) continue;
+                vl_dp_cyclic(&simd_scratch, metric, &m, pair->source, pair->source_size,
+                             pair->target, pair->target_size, costs[p]);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            unsigned long ns = elapsed_ns(&start, &end) / pairs;
+
+            for (int p = 0; p < SIMD_PAIRS; p++) {
+                if (simd_pairs[p].target_size >= VL_CYCLIC_MIN &&
+                    memcmp(expected[p], costs[p], simd_pairs[p].target_size * sizeof(int))) {
+                    mismatches++;
+                }
+            }
+            printf("%s\n    {\"modulus\": %d, \"metric\": \"%s\", \"pairs\": %d, "
+                   "\"mismatches\": %ld, \"ns\": %lu, \"plain_ns\": %lu}",
+                   first ? "" : ",", moduli[k], metric == VL_METRIC_L1 ? "l1" : "l2",
+                   pairs, mismatches, ns, plain_ns);
+            first = 0;
+        }
+    }
+    printf("\n  ],\n");
+}
+
+// Cheapest voicing vl_voicings_enumerate visits, by the L1 distance of
+// sorted voices that vl_voicing_nearest minimizes without a metric
+typedef struct _voicing_brute {
+    const int *current;
+    int voices;
+    int best;
+} voicing_brute_t;
+
+static int voicing_visit(const int *voicing, void *arg) {
+    voicing_brute_t *b = arg;
+    int cost = 0;
+    for (int i = 0; i < b->voices; i++) {
+        cost += abs(voicing[i] - b->current[i]);
+    }
+    if (cost < b->best) b->best = cost;
+    return 0;
+}
+
+// vl_voicing_nearest against a full enumeration on every corpus chord,
+// each from a random sorted voicing in C3-C5, any tone doubled
+static void print_voicings(void) {
+    static const int low = 48, high = 72;
+    vl_voicing_rules_t rules;
+    unsigned int rng = 12345;
+    int first = 1;
+
+    // Root-only doubling leaves most triads no 7- or 8-voice voicing at all
+    vl_voicing_rules_default(&rules);
+    rules.doubling = VL_DOUBLE_ANY;
+    printf("  \"voicings\": [");
+    for (int voices = VOICINGS_MIN; voices <= VOICINGS_MAX; voices++) {
+        unsigned long *samples = malloc(VL_SONG_MAX_CHORDS * MAX_PROGRESSIONS *
+                                        sizeof(unsigned long));
+        long count = 0, mismatches = 0, nodes = 0, enumerated = 0;
+        if (!samples) return;
+
+        for (int p = 0; p < progression_count; p++) {
+            for (int c = 0; c < progressions[p].count; c++) {
+                const vl_chord_t *chord = &progressions[p].chords[c];
+                int pcs[VL_MAX_VOICES];
+                int current[VL_MAX_VOICES];
+                int voicing[VL_MAX_VOICES];
+                long chord_nodes;
+                struct timespec start, end;
+
+                target_pcs(chord, pcs);
+                for (int i = 0; i < voices; i++) {
+                    current[i] = low + vl_random(&rng) % (high - low);
+                }
+                qsort(current, voices, sizeof(int), compare_ints);
+
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                int cost = vl_voicing_nearest(NULL, &rules, pcs, chord->size, chord->root,
+                                              current, voices, voicing, &chord_nodes);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                samples[count++] = elapsed_ns(&start, &end);
+                nodes += chord_nodes;
+
+                voicing_brute_t brute = { current, voices, VL_VERYLARGENUMBER };
+                enumerated += vl_voicings_enumerate(&rules, pcs, chord->size, chord->root,
+                                                    voices, voicing_visit, &brute);
+                if (brute.best == VL_VERYLARGENUMBER) brute.best = -1;
+                if (brute.best != cost) mismatches++;
+            }
+        }
+
+        qsort(samples, count, sizeof(unsigned long), compare_ulongs);
+        printf("%s\n    {\"voices\": %d, \"chords\": %ld, \"mismatches\": %ld, "
+               "\"ns\": {\"p50\": %lu, \"p99\": %lu, \"max\": %lu}, "
+               "\"nodes\": %ld, \"enumerated\": %ld}",
+               first ? "" : ",", voices, count, mismatches,
+               samples[count / 2], samples[(long)(count * 0.99)], samples[count - 1],
+               nodes / count, enumerated / count);
+        first = 0;
+        free(samples);
+    }
+    printf("\n  ],\n");
+}
+
+int main(int argc, char **argv) {
+    int iterations = 1000;
+    const char *table_path = VL_TABLE_FILENAME;
+    int arg = 1;
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) iterations = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc) table_path = argv[++arg];
+        else break;
+    }
+    if (argc - arg != 2 || iterations < 1) {
+        fprintf(stderr, "usage: %s [-n iterations] [-t table] <songs dir> <chords.txt>\n",
+                argv[0]);
+        return 1;
+    }
+    if (load_corpus(argv[arg], argv[arg + 1]) != 0) return 1;
+
+    int steps = 0;
+    for (int p = 0; p < progression_count; p++) steps += progressions[p].count;
+
+    int table_status = vl_table_open(&table, table_path);
+    vl_cache_clear(&cache);
+    vl_modulus_init(&modulus, VL_MODULUS);
+
+    size_t arena_bytes = (ENGINE_COUNT + 1) * VL_SCRATCH_BYTES(VL_MAX_SIZE);
+    vl_arena_init(&arena, malloc(arena_bytes), arena_bytes);
+    vl_scratch_init(&simd_scratch, &arena, VL_MAX_SIZE);
+
+    for (int i = 0; i < ENGINE_COUNT; i++) {
+        engine_t *e = &engines[i];
+        vl_scratch_init(&e->state.scratch, &arena, VL_MAX_SIZE);
+        e->state.ctx.scratch = &e->state.scratch;
+        e->state.ctx.topn = 1;
+        e->state.ctx.metric = VL_METRIC_L1;
+        e->state.ctx.modulus = &modulus;
+        if (i == 0) {
+            e->state.ctx.table = table_status == VL_TABLE_OK ? &table : NULL;
+            e->state.ctx.cache = &cache;
+        }
+        e->samples = malloc((size_t)iterations * steps * sizeof(unsigned long));
+        e->outputs = malloc(steps * sizeof(*e->outputs));
+        e->output_sizes = malloc(steps * sizeof(int));
+        if (!e->samples || !e->outputs || !e->output_sizes) {
+            fprintf(stderr, "vl_bench: out of memory\n");
+            return 1;
+        }
+        run_engine(e, iterations);
+        qsort(e->samples, e->sample_count, sizeof(unsigned long), compare_ulongs);
+    }
+
+    printf("{\n");
+    printf("  \"iterations\": %d,\n", iterations);
+    printf("  \"progressions\": %d,\n", progression_count);
+    printf("  \"chords\": %d,\n", steps);
+    printf("  \"table\": %s,\n", table_status == VL_TABLE_OK ? "true" : "false");
+    printf("  \"engines\": [");
+    for (int i = 0; i < ENGINE_COUNT; i++) {
+        engine_t *e = &engines[i];
+        printf("%s\n    {\"name\": \"%s\", \"calls\": %ld, "
+               "\"ns\": {\"p50\": %lu, \"p99\": %lu, \"max\": %lu}, \"motion\": %ld}",
+               i ? "," : "", e->name, e->sample_count,
+               e->samples[e->sample_count / 2],
+               e->samples[(long)(e->sample_count * 0.99)],
+               e->samples[e->sample_count - 1], e->motion);
+    }
+    printf("\n  ],\n");
+    print_simd();
+    print_cyclic();
+    print_voicings();
+    print_differences(steps);
+    printf("}\n");
+
+    vl_table_close(&table);
+    return 0;
+}
@@ -0,0 +1,91 @@
+// Recorded engine input - see vl_record.h
+#include <string.h>
+#include "vl_record.h"
+
+const char *const vl_record_kinds[VL_RECORD_KINDS] = {
+    "current", "root", "chord", "target", "feedback", "output"
+};
+
+int vl_record_kind(const char *name) {
+    for (int k = 0; k < VL_RECORD_KINDS; k++) {
+        if (strcmp(name, vl_record_kinds[k]) == 0) return k;
+    }
+    return -1;
+}
+
+int vl_record_create(vl_record_t *record, const char *path, const char *engine) {
+    memset(&record->header, 0, sizeof(record->header));
+    memcpy(record->header.magic, VL_RECORD_MAGIC, 4);
+    record->header.version = VL_RECORD_VERSION;
+    snprintf(record->header.engine, sizeof(record->header.engine), "%s", engine);
+    record->events = 0;
+
+    record->file = fopen(path, "wb");
+    if (!record->file) return -1;
+    if (fwrite(&record->header, sizeof(record->header), 1, record->file) != 1) {
+        vl_record_close(record);
+        return -1;
+    }
+    return 0;
+}
+
+int vl_record_write(vl_record_t *record, unsigned int time, int kind,
+                    const int *values, int count) {
+    if (count > VL_RECORD_MAX_VALUES) count = VL_RECORD_MAX_VALUES;
+
+    vl_record_event_t event;
+    event.time = time;
+    event.kind = (unsigned char)kind;
+    event.count = (unsigned char)count;
+    event.reserved = 0;
+    short packed[VL_RECORD_MAX_VALUES];
+    for (int i = 0; i < count; i++) {
+        packed[i] = (short)values[i];
+    }
+
+    if (fwrite(&event, sizeof(event), 1, record->file) != 1 ||
+        fwrite(packed, sizeof(short), count, record->file) != (size_t)count) {
+        return -1;
+    }
+    record->events++;
+    return 0;
+}
+
+int vl_record_open(vl_record_t *record, const char *path) {
+    record->events = 0;
+    record->file = fopen(path, "rb");
+    if (!record->file) return -1;
+
+    if (fread(&record->header, sizeof(record->header), 1, record->file) != 1 ||
+        memcmp(record->header.magic, VL_RECORD_MAGIC, 4) != 0 ||
+        record->header.version != VL_RECORD_VERSION) {
+        vl_record_close(record);
+        return -1;
+    }
+    record->header.engine[sizeof(record->header.engine) - 1] = '\0';
+    return 0;
+}
+
+int vl_record_read(vl_record_t *record, vl_record_event_t *event, int *values) {
+    short packed[255];
+    if (fread(event, sizeof(*event), 1, record->file) != 1 ||
+        fread(packed, sizeof(short), event->count, record->file) != event->count ||
+        event->kind >= VL_RECORD_KINDS || event->count > VL_RECORD_MAX_VALUES) {
+        return 0;
+    }
+    for (int i = 0; i < event->count; i++) {
+        values[i] = packed[i];
+    }
+    record->events++;
+    return 1;
+}
+
+void vl_record_rewind(vl_record_t *record) {
+    fseek(record->file, sizeof(vl_record_header_t), SEEK_SET);
+    record->events = 0;
+}
+
+void vl_record_close(vl_record_t *record) {
+    if (record->file) fclose(record->file);
+    record->file = NULL;
+}
@@ -0,0 +1,81 @@
+// Recorded engine input, for replaying a performance offline
+//
+// The recorder external sits in front of voice_leading, orbifold or
+// hungarian and logs every 'current', 'root', 'chord', 'target' and
+// 'feedback' it passes on, plus the chord the engine sent back (its right
+// inlet), each with the Pd logical time since 'open'. vl_replay feeds the
+// log through the same engine in libvoicelead as fast as it can, checks
+// each chord against the recorded one and reports throughput, so one
+// gig's log benchmarks any later build.
+//
+// Layout: one vl_record_header_t, then events, each a vl_record_event_t
+// followed by count 16-bit values. Values are whole numbers (MIDI notes,
+// intervals, 0/1), as the engines read them.
+//
+// Bump VL_RECORD_VERSION whenever the format changes.
+
+#ifndef VL_RECORD_H
+#define VL_RECORD_H
+
+#include <stdio.h>
+#include "voicelead.h"
+
+#define VL_RECORD_MAGIC "VLRC"
+#define VL_RECORD_VERSION 1
+#define VL_RECORD_MAX_VALUES VL_MAX_ENSEMBLE
+
+// Event kinds; the first five are the engine messages of the same name
+#define VL_RECORD_CURRENT 0
+#define VL_RECORD_ROOT 1
+#define VL_RECORD_CHORD 2
+#define VL_RECORD_TARGET 3
+#define VL_RECORD_FEEDBACK 4
+#define VL_RECORD_OUTPUT 5    // Chord the engine sent for the message before
+#define VL_RECORD_KINDS 6
+
+// "current", "root", "chord", "target", "feedback", "output"
+extern const char *const vl_record_kinds[VL_RECORD_KINDS];
+
+typedef struct _vl_record_header {
+    char magic[4];
+    unsigned int version;
+    char engine[16];        // "voice_leading", "orbifold" or "hungarian"
+} vl_record_header_t;
+
+typedef struct _vl_record_event {
+    unsigned int time;      // Pd logical milliseconds since 'open'
+    unsigned char kind;     // VL_RECORD_*
+    unsigned char count;    // Values that follow
+    unsigned short reserved;
+} vl_record_event_t;
+
+typedef struct _vl_record {
+    FILE *file;             // NULL when closed
+    vl_record_header_t header;
+    unsigned long events;
+} vl_record_t;
+
+// VL_RECORD_* for a message name, or -1
+int vl_record_kind(const char *name);
+
+// Start a log for engine; returns 0, or -1 if it can't be written
+int vl_record_create(vl_record_t *record, const char *path, const char *engine);
+
+// Append one event (values past VL_RECORD_MAX_VALUES are dropped);
+// returns 0, or -1 on a write error
+int vl_record_write(vl_record_t *record, unsigned int time, int kind,
+                    const int *values, int count);
+
+// Open a log for reading; returns 0, or -1 if missing or not a log of
+// this version
+int vl_record_open(vl_record_t *record, const char *path);
+
+// Next event and its values; returns 1, or 0 at the end (or a torn last event)
+int vl_record_read(vl_record_t *record, vl_record_event_t *event, int *values);
+
+// Back to the first event
+void vl_record_rewind(vl_record_t *record);
+
+void vl_record_close(vl_record_t *record);
+
+#endif
@@ -0,0 +1,330 @@
+// vl_replay - feeds a recorder log back through its engine, flat out
+//
+// Usage: vl_replay [-n iterations] [-t table] [-w voicings.txt] <log.vlrec>
+//
+// The events are read into memory, then run through the logged engine
+// (voice_leading, orbifold or hungarian, as created without arguments
+// and with no other settings changed) iterations times over, each pass
+// from the engine's starting state. Each chord is timed with
+// CLOCK_MONOTONIC into a vl_stats_t. On the first pass every chord is
+// checked against the chord the engine sent back live, when the log has
+// one, and -w writes one line per chord ("cost notes...") to diff two
+// builds with. Prints JSON on stdout:
+//   chords, checked, mismatches: chords voiced, chords with a logged
+//                                output, and how many of those differ
+//   ns:                          p50/p99/max per chord, to histogram bucket
+//   chords_per_second:           over all passes, engine time only
+// Exits 2 when any chord differs, so a script can gate on it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "voicelead.h"
+#include "vl_record.h"
+#include "vl_stats.h"
+#include "vl_table.h"
+
+#define ENGINE_VOICE_LEADING 0
+#define ENGINE_ORBIFOLD 1
+#define ENGINE_HUNGARIAN 2
+
+#define HUNGARIAN_VOICES 4      // hungarian's MAX_VOICES
+#define PENDING 64              // Chords voiced but not yet checked (async)
+#define REPORTED_MISMATCHES 5   // Printed on stderr
+
+typedef struct _event {
+    vl_record_event_t header;
+    int values[VL_RECORD_MAX_VALUES];
+} event_t;
+
+typedef struct _state {
+    int current[VL_MAX_ENSEMBLE];
+    int current_size;
+    int root;
+    int structure[VL_MAX_ENSEMBLE];   // 'chord' as sent
+    int structure_size;
+    int targets[VL_MAX_ENSEMBLE];     // voice_leading: target PCs
+    int target_size;
+    int feedback;
+} state_t;
+
+typedef struct _chord_out {
+    int notes[VL_MAX_ENSEMBLE];
+    int size;
+    int cost;
+} chord_out_t;
+
+static int engine;
+static event_t *events;
+static long event_count;
+static vl_table_t table;
+static vl_cache_t cache;
+static vl_modulus_t modulus;   // 12-EDO, as the externals start
+static vl_arena_t arena;
+static vl_scratch_t scratch;
+static vl_metric_t metric;     // Each external's default
+
+static void state_reset(state_t *s) {
+    static const int start_chord[4] = { 48, 52, 55, 60 };
+    memset(s, 0, sizeof(*s));
+    s->feedback = 1;
+    // orbifold and hungarian start on C major, voice_leading empty
+    if (engine != ENGINE_VOICE_LEADING) {
+        memcpy(s->current, start_chord, sizeof(start_chord));
+        s->current_size = 4;
+    }
+}
+
+static void voice_voice_leading(state_t *s, chord_out_t *out) {
+    vl_context_t ctx;
+    ctx.table = table.entries ? &table : NULL;
+    ctx.cache = &cache;
+    ctx.scratch = &scratch;
+    ctx.topn = 1;
+    unsigned int rng = 0;
+    ctx.rng = &rng;
+    ctx.metric = VL_METRIC_L1;
+    ctx.modulus = &modulus;
+
+    vl_pair_t vl[VL_MAX_PAIRS];
+    int vl_size;
+    int voiced[VL_MAX_ENSEMBLE];
+    out->cost = vl_nonbijective(&ctx, s->current, s->current_size,
+                                s->targets, s->target_size, vl, &vl_size);
+    int size = vl_apply(&modulus, s->current, s->current_size, vl, vl_size, voiced);
+    out->size = vl_reorder_by_function(VL_MODULUS, voiced, size, s->root,
+                                       s->structure, s->structure_size, out->notes);
+
+    if (s->feedback) {
+        memcpy(s->current, voiced, size * sizeof(int));
+        s->current_size = size;
+    }
+}
+
+// Unassigned voices hold, as in vl_bench
+static void voice_orbifold(state_t *s, chord_out_t *out) {
+    int voicing[VL_MAX_VOICES];
+    int mapping[VL_MAX_VOICES];
+    vl_centroid_voicing(s->root, s->structure, s->structure_size, 60.0f, voicing);
+    out->cost = vl_assign_exact(&metric, s->current, s->current_size,
+                                voicing, s->structure_size, mapping);
+    out->size = s->current_size;
+    for (int i = 0; i < s->current_size; i++) {
+        out->notes[i] = mapping[i] >= 0 ? voicing[mapping[i]] : s->current[i];
+    }
+
+    if (s->feedback) memcpy(s->current, out->notes, out->size * sizeof(int));
+}
+
+static void voice_hungarian(state_t *s, chord_out_t *out) {
+    int pcs[HUNGARIAN_VOICES];
+    int notes[VL_MAX_VARIANTS];
+    int count, anchor;
+    int assignment[HUNGARIAN_VOICES];
+    for (int i = 0; i < s->structure_size; i++) {
+        pcs[i] = pc_mod(s->structure[i] + s->root, VL_MODULUS);
+    }
+    out->cost = vl_hungarian(&metric, s->current, s->current_size, pcs, s->structure_size,
+                             notes, &count, &anchor, assignment);
+    out->size = s->current_size;
+    for (int i = 0; i < s->current_size; i++) {
+        out->notes[i] = assignment[i] >= 0 ? notes[assignment[i]] : s->current[i];
+    }
+
+    if (s->feedback) memcpy(s->current, out->notes, out->size * sizeof(int));
+}
+
+// Apply one event as the external would; returns 1 if it voiced a chord
+static int replay_event(state_t *s, const event_t *e, chord_out_t *out) {
+    const int *v = e->values;
+    int count = e->header.count;
+    int limit = engine == ENGINE_HUNGARIAN ? HUNGARIAN_VOICES : VL_MAX_VOICES;
+
+    switch (e->header.kind) {
+    case VL_RECORD_CURRENT:
+        if (count > limit) return 0;
+        memcpy(s->current, v, count * sizeof(int));
+        s->current_size = count;
+        return 0;
+    case VL_RECORD_ROOT:
+        if (count > 0) s->root = pc_mod(v[0], VL_MODULUS);
+        // hungarian revoices its chord on a new root
+        if (engine != ENGINE_HUNGARIAN) return 0;
+        break;
+    case VL_RECORD_FEEDBACK:
+        if (count > 0) s->feedback = v[0] != 0;
+        return 0;
+    case VL_RECORD_CHORD:
+        if (count > limit) return 0;
+        memcpy(s->structure, v, count * sizeof(int));
+        s->structure_size = count;
+        for (int i = 0; i < count; i++) {
+            s->targets[i] = pc_mod(s->root + v[i], VL_MODULUS);
+        }
+        s->target_size = count;
+        break;
+    case VL_RECORD_TARGET:
+        // Only voice_leading has 'target'; it keeps the 'chord' structure
+        if (engine != ENGINE_VOICE_LEADING || count > limit) return 0;
+        for (int i = 0; i < count; i++) {
+            s->targets[i] = pc_mod(v[i], VL_MODULUS);
+        }
+        s->target_size = count;
+        break;
+    default:
+        return 0;
+    }
+
+    int size = engine == ENGINE_VOICE_LEADING ? s->target_size : s->structure_size;
+    if (s->current_size == 0 || size == 0) return 0;
+    if (engine == ENGINE_VOICE_LEADING) voice_voice_leading(s, out);
+    else if (engine == ENGINE_ORBIFOLD) voice_orbifold(s, out);
+    else voice_hungarian(s, out);
+    return 1;
+}
+
+static int load_log(const char *path) {
+    vl_record_t record;
+    if (vl_record_open(&record, path) != 0) {
+        fprintf(stderr, "vl_replay: %s is not a version %d recorder log\n",
+                path, VL_RECORD_VERSION);
+        return -1;
+    }
+
+    const char *name = record.header.engine;
+    if (strcmp(name, "voice_leading") == 0) engine = ENGINE_VOICE_LEADING;
+    else if (strcmp(name, "orbifold") == 0) engine = ENGINE_ORBIFOLD;
+    else if (strcmp(name, "hungarian") == 0) engine = ENGINE_HUNGARIAN;
+    else {
+        fprintf(stderr, "vl_replay: unknown engine '%s'\n", name);
+        vl_record_close(&record);
+        return -1;
+    }
+
+    long capacity = 0;
+    event_t e;
+    while (vl_record_read(&record, &e.header, e.values)) {
+        if (event_count == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            events = realloc(events, capacity * sizeof(event_t));
+            if (!events) {
+                fprintf(stderr, "vl_replay: out of memory\n");
+                vl_record_close(&record);
+                return -1;
+            }
+        }
+        events[event_count++] = e;
+    }
+    vl_record_close(&record);
+    return 0;
+}
+
+static void print_chord(FILE *f, const int *notes, int size) {
+    for (int i = 0; i < size; i++) {
+        fprintf(f, "%s%d", i ? " " : "", notes[i]);
+    }
+}
+
+int main(int argc, char **argv) {
+    int iterations = 1;
+    const char *table_path = VL_TABLE_FILENAME;
+    const char *voicings_path = NULL;
+    int arg = 1;
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) iterations = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc) table_path = argv[++arg];
+        else if (strcmp(argv[arg], "-w") == 0 && arg + 1 < argc) voicings_path = argv[++arg];
+        else break;
+    }
+    if (argc - arg != 1 || iterations < 1) {
+        fprintf(stderr, "usage: %s [-n iterations] [-t table] [-w voicings.txt] <log.vlrec>\n",
+                argv[0]);
+        return 1;
+    }
+    if (load_log(argv[arg]) != 0) return 1;
+
+    FILE *voicings = NULL;
+    if (voicings_path && !(voicings = fopen(voicings_path, "w"))) {
+        perror(voicings_path);
+        return 1;
+    }
+
+    int table_status = engine == ENGINE_VOICE_LEADING ? vl_table_open(&table, table_path)
+                                                      : VL_TABLE_MISSING;
+    vl_cache_clear(&cache);
+    vl_modulus_init(&modulus, VL_MODULUS);
+    vl_metric_default(&metric);
+    size_t arena_bytes = VL_SCRATCH_BYTES(VL_MAX_SIZE);
+    vl_arena_init(&arena, malloc(arena_bytes), arena_bytes);
+    vl_scratch_init(&scratch, &arena, VL_MAX_SIZE);
+
+    static vl_stats_t stats;
+    static chord_out_t pending[PENDING];
+    long chords = 0, checked = 0, mismatches = 0;
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        state_t state;
+        state_reset(&state);
+        unsigned int voiced = 0, compared = 0;
+
+        for (long i = 0; i < event_count; i++) {
+            const event_t *e = &events[i];
+
+            // The live chord for the oldest one voiced and not yet checked
+            if (e->header.kind == VL_RECORD_OUTPUT) {
+                if (iteration > 0 || compared == voiced) continue;
+                const chord_out_t *out = &pending[compared++ % PENDING];
+                checked++;
+                if (out->size != e->header.count ||
+                    memcmp(out->notes, e->values, out->size * sizeof(int)) != 0) {
+                    if (mismatches++ < REPORTED_MISMATCHES) {
+                        fprintf(stderr, "vl_replay: event %ld at %u ms: live [", i,
+                                e->header.time);
+                        print_chord(stderr, e->values, e->header.count);
+                        fprintf(stderr, "], replayed [");
+                        print_chord(stderr, out->notes, out->size);
+                        fprintf(stderr, "]\n");
+                    }
+                }
+                continue;
+            }
+
+            chord_out_t *out = &pending[voiced % PENDING];
+            unsigned long long start = vl_stats_now();
+            int hot = replay_event(&state, e, out);
+            if (!hot) continue;
+            vl_stats_add(&stats, vl_stats_now() - start, 0, out->cost);
+            chords++;
+
+            if (iteration == 0) {
+                voiced++;
+                if (voiced - compared > PENDING) compared = voiced - PENDING;
+                if (voicings) {
+                    fprintf(voicings, "%d ", out->cost);
+                    print_chord(voicings, out->notes, out->size);
+                    fprintf(voicings, "\n");
+                }
+            }
+        }
+    }
+    if (voicings) fclose(voicings);
+
+    printf("{\n");
+    printf("  \"engine\": \"%s\",\n", engine == ENGINE_VOICE_LEADING ? "voice_leading"
+                                      : engine == ENGINE_ORBIFOLD ? "orbifold" : "hungarian");
+    printf("  \"iterations\": %d,\n", iterations);
+    printf("  \"events\": %ld,\n", event_count);
+    printf("  \"table\": %s,\n", table_status == VL_TABLE_OK ? "true" : "false");
+    printf("  \"chords\": %ld,\n", chords);
+    printf("  \"checked\": %ld,\n", checked);
+    printf("  \"mismatches\": %ld,\n", mismatches);
+    printf("  \"ns\": {\"p50\": %llu, \"p99\": %llu, \"max\": %llu},\n",
+           vl_stats_percentile(&stats, 0.5), vl_stats_percentile(&stats, 0.99), stats.max_ns);
+    printf("  \"chords_per_second\": %.0f\n",
+           stats.total_ns ? chords * 1e9 / stats.total_ns : 0.0);
+    printf("}\n");
+
+    vl_table_close(&table);
+    return mismatches ? 2 : 0;
+}
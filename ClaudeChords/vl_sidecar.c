@@ -0,0 +1,133 @@
+// Precompiled per-song voicings - see vl_sidecar.h
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "vl_sidecar.h"
+
+unsigned long long vl_fnv1a(const void *data, size_t size, unsigned long long hash) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= VL_FNV_PRIME;
+    }
+    return hash;
+}
+
+int vl_file_hash(const char *path, unsigned long long *hash) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+
+    unsigned char buffer[4096];
+    size_t n;
+    *hash = VL_FNV_OFFSET;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        *hash = vl_fnv1a(buffer, n, *hash);
+    }
+
+    int status = ferror(f) ? -1 : 0;
+    fclose(f);
+    return status;
+}
+
+void vl_sidecar_path(const char *song_path, char *path, size_t size) {
+    size_t length = strlen(song_path);
+    if (length > 4 && strcmp(song_path + length - 4, ".txt") == 0) length -= 4;
+    snprintf(path, size, "%.*s%s", (int)length, song_path, VL_SIDECAR_EXTENSION);
+}
+
+int vl_sidecar_write(const char *path, unsigned long long song_hash,
+                     const vl_song_t *song, const vl_plan_t *plan, const int *start) {
+    vl_sidecar_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VL_SIDECAR_MAGIC, 4);
+    header.version = VL_SIDECAR_VERSION;
+    header.song_hash = song_hash;
+    header.voices = plan->voices;
+    header.total_cost = plan->total_cost;
+    for (int v = 0; v < plan->voices; v++) {
+        header.start[v] = (unsigned char)start[v];
+    }
+    for (int c = 0; c < song->count; c++) {
+        if (song->chords[c].bar > (int)header.bar_count) header.bar_count = song->chords[c].bar;
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    fwrite(&header, sizeof(header), 1, f);
+
+    // Bars in order; a chord stays until the next one the song names
+    vl_sidecar_bar_t record;
+    memset(&record, 0, sizeof(record));
+    int c = 0;
+    for (int bar = 1; bar <= (int)header.bar_count; bar++) {
+        record.cost = 0;
+        for (; c < song->count && song->chords[c].bar <= bar; c++) {
+            const vl_plan_bar_t *planned = &plan->bars[c];
+            for (int v = 0; v < plan->voices; v++) {
+                record.notes[v] = (unsigned char)planned->notes[v];
+            }
+            record.bass = (unsigned char)planned->bass;
+            record.voices = (unsigned char)plan->voices;
+            record.cost = (unsigned short)(record.cost + planned->cost);
+        }
+        fwrite(&record, sizeof(record), 1, f);
+    }
+
+    int status = ferror(f) ? -1 : 0;
+    if (fclose(f) != 0) status = -1;
+    return status;
+}
+
+int vl_sidecar_open(vl_sidecar_t *sidecar, const char *song_path) {
+    sidecar->header = NULL;
+    sidecar->bars = NULL;
+    sidecar->map = NULL;
+
+    char path[1024];
+    unsigned long long hash;
+    vl_sidecar_path(song_path, path, sizeof(path));
+    if (vl_file_hash(song_path, &hash) != 0) return VL_SIDECAR_MISSING;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return VL_SIDECAR_MISSING;
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(vl_sidecar_header_t)) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    const vl_sidecar_header_t *header = map;
+    if (map == MAP_FAILED ||
+        memcmp(header->magic, VL_SIDECAR_MAGIC, 4) != 0 ||
+        header->version != VL_SIDECAR_VERSION ||
+        header->song_hash != hash ||
+        header->voices < 1 || header->voices > VL_MAX_VOICES ||
+        (size_t)st.st_size != sizeof(*header) + header->bar_count * sizeof(vl_sidecar_bar_t)) {
+        if (map != MAP_FAILED) munmap(map, st.st_size);
+        return VL_SIDECAR_STALE;
+    }
+
+    sidecar->header = header;
+    sidecar->bars = (const vl_sidecar_bar_t *)(header + 1);
+    sidecar->map = map;
+    sidecar->map_bytes = st.st_size;
+    return VL_SIDECAR_OK;
+}
+
+void vl_sidecar_close(vl_sidecar_t *sidecar) {
+    if (sidecar->map) munmap(sidecar->map, sidecar->map_bytes);
+    sidecar->header = NULL;
+    sidecar->bars = NULL;
+    sidecar->map = NULL;
+}
+
+const vl_sidecar_bar_t *vl_sidecar_bar(const vl_sidecar_t *sidecar, int bar) {
+    if (!sidecar->header || bar < 1 || bar > (int)sidecar->header->bar_count) return NULL;
+    const vl_sidecar_bar_t *record = &sidecar->bars[bar - 1];
+    return record->voices ? record : NULL;
+}
@@ -0,0 +1,79 @@
+// Precompiled per-song voicings
+//
+// vl_songc runs vl_song_plan over a song file once, offline, and writes
+// the result next to it (songs/BadGuy.txt -> songs/BadGuy.vlsong). The
+// song_voicing external mmaps that sidecar, so answering "bar N" is a
+// single indexed read with nothing computed at playback time.
+//
+// The header carries the FNV-1a hash of the song file's bytes: edit the
+// song and its sidecar is stale until 'make songs' rebuilds it.
+//
+// Layout: one vl_sidecar_header_t, then bar_count vl_sidecar_bar_t
+// records, record N-1 for bar bN. A bar the song leaves out repeats the
+// one before it; bars before the first chord have voices == 0.
+//
+// Bump VL_SIDECAR_VERSION whenever the format OR the planner changes.
+
+#ifndef VL_SIDECAR_H
+#define VL_SIDECAR_H
+
+#include <stddef.h>
+#include "vl_song.h"
+
+#define VL_SIDECAR_MAGIC "VLSC"
+#define VL_SIDECAR_VERSION 1
+#define VL_SIDECAR_EXTENSION ".vlsong"
+
+#define VL_SIDECAR_OK 0
+#define VL_SIDECAR_MISSING 1
+#define VL_SIDECAR_STALE 2
+
+#define VL_FNV_OFFSET 14695981039346656037ull
+#define VL_FNV_PRIME 1099511628211ull
+
+typedef struct _vl_sidecar_header {
+    char magic[4];
+    unsigned int version;
+    unsigned long long song_hash;   // FNV-1a of the song file
+    unsigned int voices;
+    unsigned int bar_count;
+    unsigned int total_cost;
+    unsigned int reserved;
+    unsigned char start[VL_MAX_VOICES];   // Voicing the plan started from
+} vl_sidecar_header_t;
+
+typedef struct _vl_sidecar_bar {
+    unsigned char notes[VL_MAX_VOICES];   // Ascending MIDI notes
+    unsigned char bass;
+    unsigned char voices;                 // 0: no chord yet
+    unsigned short cost;                  // Motion from the previous bar
+} vl_sidecar_bar_t;
+
+typedef struct _vl_sidecar {
+    const vl_sidecar_header_t *header;   // NULL when not mapped
+    const vl_sidecar_bar_t *bars;
+    void *map;
+    size_t map_bytes;
+} vl_sidecar_t;
+
+unsigned long long vl_fnv1a(const void *data, size_t size, unsigned long long hash);
+
+// Hash a whole file; returns 0, or -1 if unreadable
+int vl_file_hash(const char *path, unsigned long long *hash);
+
+// songs/X.txt -> songs/X.vlsong
+void vl_sidecar_path(const char *song_path, char *path, size_t size);
+
+// Write the sidecar for a planned song; returns 0, or -1 on failure
+int vl_sidecar_write(const char *path, unsigned long long song_hash,
+                     const vl_song_t *song, const vl_plan_t *plan, const int *start);
+
+// mmap the sidecar of a song file read-only, checking it against the
+// song's current hash; returns VL_SIDECAR_OK/MISSING/STALE
+int vl_sidecar_open(vl_sidecar_t *sidecar, const char *song_path);
+void vl_sidecar_close(vl_sidecar_t *sidecar);
+
+// Record for bar bN, or NULL outside the song or before its first chord
+const vl_sidecar_bar_t *vl_sidecar_bar(const vl_sidecar_t *sidecar, int bar);
+
+#endif
@@ -0,0 +1,320 @@
+// Vectorized rotation costs - see vl_simd.h
+#include <stdatomic.h>
+#include <stdint.h>
+#include "voicelead.h"
+#include "vl_simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VL_SIMD_X86 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VL_SIMD_ARM 1
+#endif
+
+const char *const vl_simd_names[VL_SIMD_LEVELS] = { "scalar", "sse2", "avx2", "neon" };
+
+#define LANES 16                          // Inversions per pass, one int16 each
+#define DOUBLED (2 * VL_MAX_SIZE + LANES)   // Target written out twice, plus a pass of slack
+
+// How each lane's cell is scored and folded, as in voicelead.c
+#define VCELL_L1(isa, d) (d)
+#define VCELL_L2(isa, d) isa##_mul(d, d)
+#define VFOLD_SUM(isa, a, b) isa##_add(a, b)
+#define VFOLD_MAX(isa, a, b) isa##_max(a, b)
+
+// PC distance lane by lane: wrap t - s into [0, n), then the shorter way
+#define DIST_OP(isa, ATTR) \
+ATTR static inline isa##_t isa##_dist(isa##_t t, isa##_t s, isa##_t n) { \
+    isa##_t diff = isa##_sub(t, s); \
+    diff = isa##_add(diff, isa##_and(isa##_sra15(diff), n)); \
+    return isa##_min(diff, isa##_sub(n, diff)); \
+}
+
+// Cumulative DP for all inversions at once, one row of vectors at a time,
+// LANES inversions per pass. Both lists are closed as in vl_dp_cost: row
+// target_size is the doubled target's next PC, the lane's first again, and
+// column source_size is source[0]. The last cell counts as zero, so the
+// answer is its cheapest predecessor.
+#define DP_ROTATIONS(isa, ATTR, name, VCELL, VFOLD) \
+ATTR static void dp_rotations_##isa##_##name(int modulus, \
+                                             const int *source, int source_size, \
+                                             const int *target, int target_size, \
+                                             int *costs) { \
+    short doubled[DOUBLED]; \
+    short out[LANES]; \
+    isa##_t src[VL_DP_SIZE]; \
+    isa##_t row[VL_DP_SIZE]; \
+    isa##_t n = isa##_set1(modulus); \
+    for (int k = 0; k < DOUBLED; k++) { \
+        doubled[k] = (short)target[k % target_size]; \
+    } \
+    for (int j = 0; j < source_size; j++) { \
+        src[j] = isa##_set1(source[j]); \
+    } \
+    src[source_size] = src[0]; \
+    int columns = source_size + 1; \
+    for (int base = 0; base < target_size; base += LANES) { \
+        for (int j = 0; j < columns; j++) { \
+            row[j] = isa##_zero(); \
+        } \
+        isa##_t diag = isa##_zero(); \
+        for (int i = 0; i <= target_size; i++) { \
+            isa##_t t = isa##_load(doubled + base + i); \
+            int end = i == target_size ? columns - 1 : columns; \
+            for (int j = 0; j < end; j++) { \
+                isa##_t cell = VCELL(isa, isa##_dist(t, src[j], n)); \
+                isa##_t up = row[j]; \
+                if (i == 0) row[j] = j ? VFOLD(isa, row[j - 1], cell) : cell; \
+                else if (j == 0) row[j] = VFOLD(isa, up, cell); \
+                else row[j] = VFOLD(isa, isa##_min(isa##_min(diag, up), row[j - 1]), cell); \
+                diag = up; \
+            } \
+        } \
+        isa##_t last = isa##_min(isa##_min(diag, row[columns - 1]), row[columns - 2]); \
+        isa##_store(out, last); \
+        for (int r = 0; r < LANES && base + r < target_size; r++) { \
+            costs[base + r] = out[r]; \
+        } \
+    } \
+}
+
+// Lane r adds up source[i] -> target[i + r] for every i
+#define BIJECTIVE_ROTATIONS(isa, ATTR) \
+ATTR static void bijective_rotations_##isa(int modulus, const int *source, \
+                                           const int *target, int size, int *costs) { \
+    short doubled[DOUBLED]; \
+    short out[LANES]; \
+    isa##_t n = isa##_set1(modulus); \
+    for (int k = 0; k < DOUBLED; k++) { \
+        doubled[k] = (short)target[k % size]; \
+    } \
+    for (int base = 0; base < size; base += LANES) { \
+        isa##_t total = isa##_zero(); \
+        for (int i = 0; i < size; i++) { \
+            total = isa##_add(total, \
+                              isa##_dist(isa##_load(doubled + base + i), isa##_set1(source[i]), n)); \
+        } \
+        isa##_store(out, total); \
+        for (int r = 0; r < LANES && base + r < size; r++) { \
+            costs[base + r] = out[r]; \
+        } \
+    } \
+}
+
+typedef void (*dp_kernel_t)(int, const int *, int, const int *, int, int *);
+
+// Everything for one instruction set; the DP has no voice order, so
+// WEIGHTED runs the L1 kernel as in voicelead.c
+#define ROTATION_KERNELS(isa, ATTR) \
+    DIST_OP(isa, ATTR) \
+    DP_ROTATIONS(isa, ATTR, l1, VCELL_L1, VFOLD_SUM) \
+    DP_ROTATIONS(isa, ATTR, l2, VCELL_L2, VFOLD_SUM) \
+    DP_ROTATIONS(isa, ATTR, linf, VCELL_L1, VFOLD_MAX) \
+    BIJECTIVE_ROTATIONS(isa, ATTR) \
+    static const dp_kernel_t dp_kernels_##isa[VL_METRIC_COUNT] = { \
+        dp_rotations_##isa##_l1, dp_rotations_##isa##_l2, \
+        dp_rotations_##isa##_linf, dp_rotations_##isa##_l1 \
+    };
+
+// ---------------------------------------------------------------------------
+// x86: SSE2 as two 8-lane halves, AVX2 as one 16-lane register. Both are
+// compiled for their own target, so the library itself needs no -m flags.
+
+#ifdef VL_SIMD_X86
+
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+
+typedef struct { __m128i lo, hi; } sse2_t;
+
+#define SSE2_BINARY(op, intrinsic) \
+SSE2 static inline sse2_t sse2_##op(sse2_t a, sse2_t b) { \
+    sse2_t r = { intrinsic(a.lo, b.lo), intrinsic(a.hi, b.hi) }; \
+    return r; \
+}
+SSE2_BINARY(add, _mm_add_epi16)
+SSE2_BINARY(sub, _mm_sub_epi16)
+SSE2_BINARY(min, _mm_min_epi16)
+SSE2_BINARY(max, _mm_max_epi16)
+SSE2_BINARY(mul, _mm_mullo_epi16)
+SSE2_BINARY(and, _mm_and_si128)
+
+SSE2 static inline sse2_t sse2_sra15(sse2_t a) {
+    sse2_t r = { _mm_srai_epi16(a.lo, 15), _mm_srai_epi16(a.hi, 15) };
+    return r;
+}
+SSE2 static inline sse2_t sse2_set1(int value) {
+    sse2_t r = { _mm_set1_epi16((short)value), _mm_set1_epi16((short)value) };
+    return r;
+}
+SSE2 static inline sse2_t sse2_zero(void) {
+    sse2_t r = { _mm_setzero_si128(), _mm_setzero_si128() };
+    return r;
+}
+SSE2 static inline sse2_t sse2_load(const short *p) {
+    sse2_t r = { _mm_loadu_si128((const __m128i *)p), _mm_loadu_si128((const __m128i *)(p + 8)) };
+    return r;
+}
+SSE2 static inline void sse2_store(short *p, sse2_t a) {
+    _mm_storeu_si128((__m128i *)p, a.lo);
+    _mm_storeu_si128((__m128i *)(p + 8), a.hi);
+}
+
+ROTATION_KERNELS(sse2, SSE2)
+
+typedef __m256i avx2_t;
+
+AVX2 static inline avx2_t avx2_add(avx2_t a, avx2_t b) { return _mm256_add_epi16(a, b); }
+AVX2 static inline avx2_t avx2_sub(avx2_t a, avx2_t b) { return _mm256_sub_epi16(a, b); }
+AVX2 static inline avx2_t avx2_min(avx2_t a, avx2_t b) { return _mm256_min_epi16(a, b); }
+AVX2 static inline avx2_t avx2_max(avx2_t a, avx2_t b) { return _mm256_max_epi16(a, b); }
+AVX2 static inline avx2_t avx2_mul(avx2_t a, avx2_t b) { return _mm256_mullo_epi16(a, b); }
+AVX2 static inline avx2_t avx2_and(avx2_t a, avx2_t b) { return _mm256_and_si256(a, b); }
+AVX2 static inline avx2_t avx2_sra15(avx2_t a) { return _mm256_srai_epi16(a, 15); }
+AVX2 static inline avx2_t avx2_set1(int value) { return _mm256_set1_epi16((short)value); }
+AVX2 static inline avx2_t avx2_zero(void) { return _mm256_setzero_si256(); }
+AVX2 static inline avx2_t avx2_load(const short *p) {
+    return _mm256_loadu_si256((const __m256i *)p);
+}
+AVX2 static inline void avx2_store(short *p, avx2_t a) {
+    _mm256_storeu_si256((__m256i *)p, a);
+}
+
+ROTATION_KERNELS(avx2, AVX2)
+
+#endif
+
+// ---------------------------------------------------------------------------
+// ARM: NEON as two 8-lane halves (armv7 with -mfpu=neon, and all aarch64)
+
+#ifdef VL_SIMD_ARM
+
+#define NEON
+
+typedef struct { int16x8_t lo, hi; } neon_t;
+
+#define NEON_BINARY(op, intrinsic) \
+static inline neon_t neon_##op(neon_t a, neon_t b) { \
+    neon_t r = { intrinsic(a.lo, b.lo), intrinsic(a.hi, b.hi) }; \
+    return r; \
+}
+NEON_BINARY(add, vaddq_s16)
+NEON_BINARY(sub, vsubq_s16)
+NEON_BINARY(min, vminq_s16)
+NEON_BINARY(max, vmaxq_s16)
+NEON_BINARY(mul, vmulq_s16)
+NEON_BINARY(and, vandq_s16)
+
+static inline neon_t neon_sra15(neon_t a) {
+    neon_t r = { vshrq_n_s16(a.lo, 15), vshrq_n_s16(a.hi, 15) };
+    return r;
+}
+static inline neon_t neon_set1(int value) {
+    neon_t r = { vdupq_n_s16((short)value), vdupq_n_s16((short)value) };
+    return r;
+}
+static inline neon_t neon_zero(void) {
+    return neon_set1(0);
+}
+static inline neon_t neon_load(const short *p) {
+    neon_t r = { vld1q_s16(p), vld1q_s16(p + 8) };
+    return r;
+}
+static inline void neon_store(short *p, neon_t a) {
+    vst1q_s16(p, a.lo);
+    vst1q_s16(p + 8, a.hi);
+}
+
+ROTATION_KERNELS(neon, NEON)
+
+#endif
+
+// ---------------------------------------------------------------------------
+// Dispatch
+
+static atomic_int simd_level = -1;   // Not chosen yet
+
+int vl_simd_available(int level) {
+    switch (level) {
+    case VL_SIMD_SCALAR:
+        return 1;
+#ifdef VL_SIMD_X86
+    case VL_SIMD_SSE2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+    case VL_SIMD_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+#ifdef VL_SIMD_ARM
+    case VL_SIMD_NEON:
+        return 1;
+#endif
+    }
+    return 0;
+}
+
+int vl_simd_level(void) {
+    int level = atomic_load_explicit(&simd_level, memory_order_relaxed);
+    if (level < 0) {
+        static const int preferred[] = { VL_SIMD_AVX2, VL_SIMD_SSE2, VL_SIMD_NEON };
+        level = VL_SIMD_SCALAR;
+        for (int i = 0; i < 3 && level == VL_SIMD_SCALAR; i++) {
+            if (vl_simd_available(preferred[i])) level = preferred[i];
+        }
+        atomic_store_explicit(&simd_level, level, memory_order_relaxed);
+    }
+    return level;
+}
+
+int vl_simd_force(int level) {
+    if (level < 0 || level >= VL_SIMD_LEVELS || !vl_simd_available(level)) return -1;
+    atomic_store_explicit(&simd_level, level, memory_order_relaxed);
+    return 0;
+}
+
+int vl_simd_dp_rotations(int metric, int modulus,
+                         const int *source, int source_size,
+                         const int *target, int target_size, int *costs) {
+    // int16 lanes: wide moduli with big chords could overflow under L2
+    int cell = metric == VL_METRIC_L2 ? (modulus / 2) * (modulus / 2) : modulus / 2;
+    if ((source_size + target_size) * cell > INT16_MAX) return -1;
+    switch (vl_simd_level()) {
+#ifdef VL_SIMD_X86
+    case VL_SIMD_AVX2:
+        dp_kernels_avx2[metric](modulus, source, source_size, target, target_size, costs);
+        return 0;
+    case VL_SIMD_SSE2:
+        dp_kernels_sse2[metric](modulus, source, source_size, target, target_size, costs);
+        return 0;
+#endif
+#ifdef VL_SIMD_ARM
+    case VL_SIMD_NEON:
+        dp_kernels_neon[metric](modulus, source, source_size, target, target_size, costs);
+        return 0;
+#endif
+    }
+    return -1;
+}
+
+int vl_simd_bijective_rotations(int modulus, const int *source, const int *target, int size,
+                                int *costs) {
+    switch (vl_simd_level()) {
+#ifdef VL_SIMD_X86
+    case VL_SIMD_AVX2:
+        bijective_rotations_avx2(modulus, source, target, size, costs);
+        return 0;
+    case VL_SIMD_SSE2:
+        bijective_rotations_sse2(modulus, source, target, size, costs);
+        return 0;
+#endif
+#ifdef VL_SIMD_ARM
+    case VL_SIMD_NEON:
+        bijective_rotations_neon(modulus, source, target, size, costs);
+        return 0;
+#endif
+    }
+    return -1;
+}
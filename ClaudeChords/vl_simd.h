@@ -0,0 +1,53 @@
+// Vectorized rotation costs
+//
+// vl_search scores every inversion (rotation) of the target chord, and the
+// bijective cost does the same over rotations. The inversions are
+// independent problems of the same shape, so these kernels run all of them
+// side by side, one inversion per 16-bit lane: 16 lanes are one AVX2
+// register or two SSE2/NEON registers, and bigger chords take another pass.
+// Row i of inversion r reads target[(i + r) % n], which is one unaligned
+// load from the target written out twice, so no shuffles are needed. When
+// a cost could pass 2^15 (L2 in wide EDOs with big chords) the DP is left
+// to the scalar path.
+//
+// The level is chosen once, on first use: AVX2 when the CPU has it, else
+// SSE2 on x86 or NEON when the compiler targets it (always on aarch64 and
+// on the Bela), else VL_SIMD_SCALAR, where callers fall back to the plain
+// per-rotation loop. vl_simd_force pins a level so vl_bench can check each
+// one bit for bit against the scalar path.
+
+#ifndef VL_SIMD_H
+#define VL_SIMD_H
+
+#define VL_SIMD_SCALAR 0
+#define VL_SIMD_SSE2 1
+#define VL_SIMD_AVX2 2
+#define VL_SIMD_NEON 3
+#define VL_SIMD_LEVELS 4
+
+// "scalar", "sse2", "avx2", "neon"
+extern const char *const vl_simd_names[VL_SIMD_LEVELS];
+
+// Nonzero if this build and CPU can run level
+int vl_simd_available(int level);
+
+// Level in use
+int vl_simd_level(void);
+
+// Use level from now on; returns 0, or -1 if it isn't available
+int vl_simd_force(int level);
+
+// costs[r] is the DP cost (as vl_dp_cost, metric a VL_METRIC_* kind) of
+// source against target rotated by r, for every r < target_size. Sorted
+// PCs in [0, modulus). Returns 0, or -1 (nothing written) at
+// VL_SIMD_SCALAR or when a cost might not fit a lane.
+int vl_simd_dp_rotations(int metric, int modulus,
+                         const int *source, int source_size,
+                         const int *target, int target_size, int *costs);
+
+// costs[r] is the total motion of source[i] -> target[(i + r) % size],
+// as vl_bijective scores it. Returns 0, or -1 at VL_SIMD_SCALAR.
+int vl_simd_bijective_rotations(int modulus, const int *source, const int *target, int size,
+                                int *costs);
+
+#endif
@@ -0,0 +1,282 @@
+// Song and chord-list parsing, whole-song voicing - see vl_song.h
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vl_song.h"
+
+// Same structures the chordTable patch sends
+static const struct {
+    const char *suffix;
+    int size;
+    int intervals[VL_SONG_MAX_INTERVALS];
+} qualities[] = {
+    { "",     3, { 0, 4, 7 } },
+    { "m",    3, { 0, 3, 7 } },
+    { "maj7", 4, { 0, 4, 7, 11 } },
+    { "7",    4, { 0, 4, 7, 10 } },
+    { "m7",   4, { 0, 3, 7, 10 } },
+    { "sus",  3, { 0, 5, 7 } },
+};
+
+int vl_chord_parse(const char *name, vl_chord_t *chord) {
+    static const int letter_pcs[7] = { 9, 11, 0, 2, 4, 5, 7 };   // A-G
+
+    if (name[0] < 'A' || name[0] > 'G') return -1;
+    int root = letter_pcs[name[0] - 'A'];
+    const char *suffix = name + 1;
+    if (*suffix == '#') {
+        root++;
+        suffix++;
+    } else if (*suffix == 'b') {
+        root--;
+        suffix++;
+    }
+
+    for (size_t q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++) {
+        if (strcmp(suffix, qualities[q].suffix) == 0) {
+            snprintf(chord->name, sizeof(chord->name), "%s", name);
+            chord->root = (root + 12) % 12;
+            chord->size = qualities[q].size;
+            memcpy(chord->intervals, qualities[q].intervals, sizeof(chord->intervals));
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int vl_song_load(const char *path, vl_song_t *song) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    const char *base = strrchr(path, '/');
+    snprintf(song->title, sizeof(song->title), "%s", base ? base + 1 : path);
+    song->count = 0;
+
+    char line[512];
+    while (fgets(line, sizeof(line), f) && song->count < VL_SONG_MAX_CHORDS) {
+        int bar;
+        char name[VL_SONG_NAME_LENGTH];
+        if (sscanf(line, "b%d %15s", &bar, name) == 2 &&
+            vl_chord_parse(name, &song->chords[song->count]) == 0) {
+            song->chords[song->count].bar = bar;
+            song->count++;
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+int vl_chord_list_load(const char *path, vl_song_t *song) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    snprintf(song->title, sizeof(song->title), "chords.txt");
+    song->count = 0;
+
+    char line[128];
+    while (fgets(line, sizeof(line), f) && song->count < VL_SONG_MAX_CHORDS) {
+        char name[VL_SONG_NAME_LENGTH];
+        int root;
+        vl_chord_t *chord = &song->chords[song->count];
+        if (sscanf(line, "%15s %d", name, &root) == 2 &&
+            vl_chord_parse(name, chord) == 0) {
+            chord->root = ((root % 12) + 12) % 12;
+            chord->bar = song->count + 1;
+            song->count++;
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Whole-song voicing
+
+static int compare_ints(const void *a, const void *b) {
+    return (*(const int *)a > *(const int *)b) - (*(const int *)a < *(const int *)b);
+}
+
+// Both ascending
+static int voicing_distance(const int *a, const int *b, int voices) {
+    int distance = 0;
+    for (int i = 0; i < voices; i++) {
+        distance += abs(a[i] - b[i]);
+    }
+    return distance;
+}
+
+int vl_plan_candidates(const vl_chord_t *chord, int voices,
+                       int candidates[VL_PLAN_MAX_CANDIDATES][VL_MAX_VOICES]) {
+    int count = 0;
+    for (int inversion = 0; inversion < chord->size; inversion++) {
+        int lowest_pc = pc_mod(chord->root + chord->intervals[inversion], VL_MODULUS);
+        int lowest = VL_PLAN_LOW + pc_mod(lowest_pc - VL_PLAN_LOW, VL_MODULUS);
+
+        for (; lowest < VL_PLAN_HIGH; lowest += VL_MODULUS) {
+            int *voicing = candidates[count++];
+            voicing[0] = lowest;
+            for (int v = 1; v < voices; v++) {
+                int pc = pc_mod(chord->root + chord->intervals[(inversion + v) % chord->size],
+                                VL_MODULUS);
+                voicing[v] = voicing[v - 1] + pc_mod(pc - voicing[v - 1], VL_MODULUS);
+                if (voicing[v] == voicing[v - 1]) voicing[v] += VL_MODULUS;   // Doubling
+            }
+        }
+    }
+    return count;
+}
+
+void vl_plan_cache_clear(vl_plan_cache_t *cache) {
+    for (int i = 0; i < VL_PLAN_CACHE_SETS; i++) {
+        cache->sets[i].key = 0;
+    }
+    for (int i = 0; i < VL_PLAN_CACHE_STEPS; i++) {
+        cache->steps[i].from = 0;
+    }
+    cache->hits = 0;
+    cache->misses = 0;
+}
+
+// Everything candidate generation depends on; never 0
+static unsigned int vl_plan_key(const vl_chord_t *chord, int voices) {
+    unsigned int key = (unsigned int)voices << 24 | (unsigned int)chord->size << 20 |
+                       (unsigned int)chord->root << 16;
+    for (int i = 0; i < chord->size; i++) {
+        key |= (unsigned int)chord->intervals[i] << (i * 4);
+    }
+    return key;
+}
+
+// Candidates for a chord, copied out of the cache when it has them (a
+// cache slot can be taken by the very next chord)
+static void vl_plan_set(vl_plan_cache_t *cache, const vl_chord_t *chord, int voices,
+                        vl_plan_set_t *set) {
+    unsigned int key = vl_plan_key(chord, voices);
+    vl_plan_set_t *cached = cache ? &cache->sets[(key * 2654435761u >> 16) &
+                                                 (VL_PLAN_CACHE_SETS - 1)] : NULL;
+    if (cached && cached->key == key) {
+        *set = *cached;
+        return;
+    }
+    set->key = key;
+    set->count = vl_plan_candidates(chord, voices, set->notes);
+    if (cached) *cached = *set;
+}
+
+// Cost table between two candidate sets
+static const vl_plan_step_t *vl_plan_step(vl_plan_cache_t *cache, const vl_plan_set_t *from,
+                                          const vl_plan_set_t *to, int voices,
+                                          vl_plan_step_t *local) {
+    vl_plan_step_t *step = local;
+    if (cache) {
+        unsigned int hash = (from->key * 2654435761u) ^ (to->key * 40503u);
+        step = &cache->steps[(hash >> 16) & (VL_PLAN_CACHE_STEPS - 1)];
+        if (step->from == from->key && step->to == to->key) {
+            cache->hits++;
+            return step;
+        }
+        cache->misses++;
+    }
+
+    step->from = from->key;
+    step->to = to->key;
+    for (int p = 0; p < from->count; p++) {
+        for (int k = 0; k < to->count; k++) {
+            step->cost[p][k] = (unsigned short)voicing_distance(from->notes[p], to->notes[k],
+                                                                voices);
+        }
+    }
+    return step;
+}
+
+int vl_plan_chords(vl_plan_cache_t *cache, const vl_chord_t *chords, int count,
+                   const int *start, int voices, int beam, vl_plan_t *plan) {
+    if (voices < 1 || voices > VL_MAX_VOICES || count < 0 || count > VL_SONG_MAX_CHORDS) {
+        return -1;
+    }
+
+    // Viterbi over the candidates of each chord; alive holds the previous
+    // chord's candidates still in the running (all of them without a beam)
+    unsigned char (*back)[VL_PLAN_MAX_CANDIDATES] = plan->back;
+    int origin[VL_MAX_VOICES];
+    vl_plan_set_t local_sets[2];
+    vl_plan_step_t local_step;
+    const vl_plan_set_t *previous = NULL;
+    int previous_cost[VL_PLAN_MAX_CANDIDATES], cost[VL_PLAN_MAX_CANDIDATES] = { 0 };
+    int alive[VL_PLAN_MAX_CANDIDATES], alive_count = 0;
+
+    memcpy(origin, start, voices * sizeof(int));
+    qsort(origin, voices, sizeof(int), compare_ints);
+
+    plan->voices = voices;
+    plan->total_cost = 0;
+    if (count == 0) return 0;
+
+    for (int c = 0; c < count; c++) {
+        vl_plan_set_t *set = &local_sets[c & 1];
+        vl_plan_set(cache, &chords[c], voices, set);
+        const vl_plan_step_t *step = previous
+            ? vl_plan_step(cache, previous, set, voices, &local_step) : NULL;
+
+        for (int k = 0; k < set->count; k++) {
+            if (!step) {
+                cost[k] = voicing_distance(origin, set->notes[k], voices);
+                back[c][k] = 0;
+                continue;
+            }
+            cost[k] = VL_VERYLARGENUMBER * VL_MAX_VOICES;
+            for (int a = 0; a < alive_count; a++) {
+                int p = alive[a];
+                int total = previous_cost[p] + step->cost[p][k];
+                if (total < cost[k] || (total == cost[k] && p < back[c][k])) {
+                    cost[k] = total;
+                    back[c][k] = (unsigned char)p;
+                }
+            }
+        }
+
+        // Survivors, cheapest first (ties by candidate order)
+        alive_count = 0;
+        for (int k = 0; k < set->count; k++) {
+            int a = alive_count;
+            while (a > 0 && cost[alive[a - 1]] > cost[k]) {
+                alive[a] = alive[a - 1];
+                a--;
+            }
+            alive[a] = k;
+            alive_count++;
+        }
+        if (beam > 0 && alive_count > beam) alive_count = beam;
+
+        memcpy(previous_cost, cost, set->count * sizeof(int));
+        previous = set;
+    }
+
+    int best = alive[0];
+    plan->total_cost = cost[best];
+
+    // Walk back, regenerating each chord's candidates
+    int candidates[VL_PLAN_MAX_CANDIDATES][VL_MAX_VOICES];
+    for (int c = count - 1; c >= 0; c--) {
+        vl_plan_bar_t *bar = &plan->bars[c];
+        vl_plan_candidates(&chords[c], voices, candidates);
+        memcpy(bar->notes, candidates[best], voices * sizeof(int));
+
+        int bass_octave = bar->notes[0] / 12 - 1;
+        if (bass_octave < 2) bass_octave = 2;
+        bar->bass = bass_octave * 12 + chords[c].root;
+
+        best = back[c][best];
+    }
+    for (int c = 0; c < count; c++) {
+        const int *from = c > 0 ? plan->bars[c - 1].notes : origin;
+        plan->bars[c].cost = voicing_distance(from, plan->bars[c].notes, voices);
+    }
+    return plan->total_cost;
+}
+
+int vl_song_plan(const vl_song_t *song, const int *start, int voices, vl_plan_t *plan) {
+    return vl_plan_chords(NULL, song->chords, song->count, start, voices, 0, plan);
+}
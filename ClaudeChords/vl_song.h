@@ -0,0 +1,107 @@
+// Song and chord-list files used by the offline tools
+//
+// Songs (Euphorium_03/songs/*.txt) are "key: value" headers followed by
+// "bN <chord>" bar lines and "lN <lyrics>" lines; only the bars matter
+// here. chords.txt is one "<name> <root pc>" per line. Chord names are a
+// root letter, an optional # or b, and a quality: "", m, maj7, 7, m7, sus.
+
+#ifndef VL_SONG_H
+#define VL_SONG_H
+
+#include "voicelead.h"
+
+#define VL_SONG_MAX_CHORDS 512
+#define VL_SONG_MAX_INTERVALS 4
+#define VL_SONG_NAME_LENGTH 16
+
+typedef struct _vl_chord {
+    char name[VL_SONG_NAME_LENGTH];
+    int bar;                                 // bN in the song, or line order
+    int root;                                // Pitch class 0-11
+    int intervals[VL_SONG_MAX_INTERVALS];    // From the root, as 'chord' takes them
+    int size;
+} vl_chord_t;
+
+typedef struct _vl_song {
+    char title[128];
+    int count;
+    vl_chord_t chords[VL_SONG_MAX_CHORDS];
+} vl_song_t;
+
+// Parse a chord name; returns 0, or -1 if it is not one
+int vl_chord_parse(const char *name, vl_chord_t *chord);
+
+// Read the bar chords of a song file; returns 0, or -1 if unreadable.
+// Unparseable bars are skipped.
+int vl_song_load(const char *path, vl_song_t *song);
+
+// Read chords.txt as one progression, roots taken from the file
+int vl_chord_list_load(const char *path, vl_song_t *song);
+
+// ---------------------------------------------------------------------------
+// Whole-song voicing: every chord gets the close-position voicing (any
+// inversion, lowest note in [VL_PLAN_LOW, VL_PLAN_HIGH)) that minimizes the
+// total motion over the song, not just the next step. Motion between
+// voicings is the sorted L1 distance, as vl_bench measures it. Chord tones
+// are repeated upwards to fill the voice count (root doubled for triads).
+
+#define VL_PLAN_LOW 40
+#define VL_PLAN_HIGH 64
+#define VL_PLAN_MAX_CANDIDATES \
+    (VL_SONG_MAX_INTERVALS * ((VL_PLAN_HIGH - VL_PLAN_LOW + 11) / 12))
+
+typedef struct _vl_plan_bar {
+    int notes[VL_MAX_VOICES];   // Ascending
+    int bass;                   // Root an octave below the voicing (orbifold's rule)
+    int cost;                   // Motion from the previous voicing
+} vl_plan_bar_t;
+
+typedef struct _vl_plan {
+    int voices;
+    int total_cost;
+    vl_plan_bar_t bars[VL_SONG_MAX_CHORDS];   // One per song chord
+    unsigned char back[VL_SONG_MAX_CHORDS][VL_PLAN_MAX_CANDIDATES];   // Working memory
+} vl_plan_t;
+
+// Candidate sets and chord-to-chord cost tables, kept between plans: a
+// progression keeps returning to the same few chords and chord changes.
+// Direct-mapped; a collision just recomputes.
+#define VL_PLAN_CACHE_SETS 64     // Power of two
+#define VL_PLAN_CACHE_STEPS 256   // Power of two
+
+typedef struct _vl_plan_set {
+    unsigned int key;   // vl_plan_key, 0 = empty
+    int count;
+    int notes[VL_PLAN_MAX_CANDIDATES][VL_MAX_VOICES];
+} vl_plan_set_t;
+
+typedef struct _vl_plan_step {
+    unsigned int from;   // Keys of both chords, 0 = empty
+    unsigned int to;
+    unsigned short cost[VL_PLAN_MAX_CANDIDATES][VL_PLAN_MAX_CANDIDATES];
+} vl_plan_step_t;
+
+typedef struct _vl_plan_cache {
+    vl_plan_set_t sets[VL_PLAN_CACHE_SETS];
+    vl_plan_step_t steps[VL_PLAN_CACHE_STEPS];
+    unsigned long hits;     // Cost tables reused
+    unsigned long misses;   // Cost tables computed
+} vl_plan_cache_t;
+
+void vl_plan_cache_clear(vl_plan_cache_t *cache);
+
+// Close-position candidates for a chord; returns how many
+int vl_plan_candidates(const vl_chord_t *chord, int voices,
+                       int candidates[VL_PLAN_MAX_CANDIDATES][VL_MAX_VOICES]);
+
+// Globally cheapest voicings for a chord sequence, from start (voices
+// pitches). beam > 0 keeps only that many cheapest paths after each chord
+// (0 = exact Viterbi); cache may be NULL. Returns the total cost, or -1 if
+// voices or count is out of range.
+int vl_plan_chords(vl_plan_cache_t *cache, const vl_chord_t *chords, int count,
+                   const int *start, int voices, int beam, vl_plan_t *plan);
+
+// Exact plan for a whole song
+int vl_song_plan(const vl_song_t *song, const int *start, int voices, vl_plan_t *plan);
+
+#endif
@@ -0,0 +1,79 @@
+// vl_songc - compiles song files into voicing sidecars (see vl_sidecar.h)
+//
+// Usage: vl_songc [-s "48 52 55 60"] <song.txt>...
+//
+// Each song's bars are voiced once with vl_song_plan, starting from the
+// -s voicing (C major, 4 voices, by default), and written next to the
+// song as <song>.vlsong. A sidecar whose song hash already matches is
+// left alone. Files are written to .tmp and renamed, so an interrupted
+// run never leaves a valid-looking sidecar.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vl_sidecar.h"
+
+static vl_song_t song;
+static vl_plan_t plan;
+
+static int compile(const char *song_path, const int *start, int voices) {
+    char path[1024], tmp_path[1040];
+    unsigned long long hash;
+    vl_sidecar_t existing;
+
+    // Up to date: same song bytes, same starting voicing
+    if (vl_sidecar_open(&existing, song_path) == VL_SIDECAR_OK) {
+        int same = existing.header->voices == (unsigned int)voices;
+        for (int v = 0; v < voices; v++) {
+            if (existing.header->start[v] != start[v]) same = 0;
+        }
+        vl_sidecar_close(&existing);
+        if (same) return 0;
+    }
+
+    if (vl_file_hash(song_path, &hash) != 0 || vl_song_load(song_path, &song) != 0) {
+        perror(song_path);
+        return -1;
+    }
+    vl_song_plan(&song, start, voices, &plan);
+
+    vl_sidecar_path(song_path, path, sizeof(path));
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    if (vl_sidecar_write(tmp_path, hash, &song, &plan, start) != 0 ||
+        rename(tmp_path, path) != 0) {
+        perror(path);
+        remove(tmp_path);
+        return -1;
+    }
+
+    printf("vl_songc: %s: %d chords, total motion %d\n", path, song.count, plan.total_cost);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int start[VL_MAX_VOICES] = { 48, 52, 55, 60 };
+    int voices = 4;
+    int arg = 1;
+
+    if (arg + 1 < argc && strcmp(argv[arg], "-s") == 0) {
+        char *p = argv[arg + 1], *end;
+        voices = 0;
+        while (voices < VL_MAX_VOICES) {
+            long note = strtol(p, &end, 10);
+            if (end == p) break;
+            start[voices++] = (int)note;
+            p = end;
+        }
+        arg += 2;
+    }
+    if (arg >= argc || voices < 1) {
+        fprintf(stderr, "usage: %s [-s \"48 52 55 60\"] <song.txt>...\n", argv[0]);
+        return 1;
+    }
+
+    int status = 0;
+    for (; arg < argc; arg++) {
+        if (compile(argv[arg], start, voices) != 0) status = 1;
+    }
+    return status;
+}
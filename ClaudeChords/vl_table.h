@@ -0,0 +1,81 @@
+// Precomputed all-pairs voice-leading table
+//
+// There are only 4095 non-empty pitch-class sets, so the nonbijective
+// answer for every (source set, target set) pair fits in one file.
+// vl_tablegen writes it; voice_leading mmaps it read-only at load, so a
+// lookup is a single indexed read shared by every instance (and every Pd
+// process on the machine, through the page cache).
+//
+// Pairs are stored transposition-normalized (see pcset_canonical_pair): the
+// voice leading from T_n(A) to T_n(B) is the one from A to B shifted by n,
+// so only the 351 transposition classes of source sets need a row.
+//
+// Layout: one vl_table_header_t followed by VL_TABLE_CLASSES * VL_TABLE_SETS
+// entries, row = canonical source class, column = canonical target set
+// (see vl_table_index).
+//
+// Bump VL_TABLE_VERSION whenever the format OR the DP it mirrors changes;
+// voice_leading refuses files with a different version and falls back to
+// the live search.
+
+#ifndef VL_TABLE_H
+#define VL_TABLE_H
+
+#include "pcset.h"
+
+#define VL_TABLE_MAGIC "VLTB"
+#define VL_TABLE_VERSION 4
+#define VL_TABLE_MODULUS 12
+#define VL_TABLE_SETS ((1 << VL_TABLE_MODULUS) - 1)  // Non-empty 12-bit sets
+#define VL_TABLE_CLASSES 351  // Transposition classes of non-empty sets
+#define VL_TABLE_FILENAME "voice_leading.vltable"
+
+// DP path steps, 2 bits each, starting from (target 0, source 0)
+#define VL_MOVE_END 0
+#define VL_MOVE_DIAGONAL 1   // Next target and next source
+#define VL_MOVE_TARGET 2     // Next target, same source
+#define VL_MOVE_SOURCE 3     // Same target, next source
+#define VL_TABLE_MAX_MOVES 24
+
+typedef struct _vl_table_header {
+    char magic[4];
+    unsigned int version;
+    unsigned int modulus;
+    unsigned int entry_size;
+    unsigned int set_count;
+    unsigned int class_count;
+    unsigned int reserved[2];
+} vl_table_header_t;
+
+typedef struct _vl_table_entry {
+    unsigned char cost;       // Nonbijective cost
+    unsigned char rotation;   // Nonbijective target rotation
+    unsigned char moves[VL_TABLE_MAX_MOVES / 4];
+} vl_table_entry_t;
+
+// Number each canonical source set 0..VL_TABLE_CLASSES-1 (-1 otherwise)
+static inline void vl_table_class_index(short index[VL_TABLE_SETS + 1]) {
+    short count = 0;
+    index[0] = -1;
+    for (pcset_t set = 1; set <= VL_TABLE_SETS; set++) {
+        pcset_t canonical_source, canonical_target;
+        int shift;
+        pcset_canonical_pair(set, set, VL_TABLE_MODULUS,
+                             &canonical_source, &canonical_target, &shift);
+        index[set] = (canonical_source == set) ? count++ : -1;
+    }
+}
+
+static inline unsigned long vl_table_index(int source_class, pcset_t target) {
+    return (unsigned long)source_class * VL_TABLE_SETS + (target - 1);
+}
+
+static inline int vl_table_move(const vl_table_entry_t *e, int step) {
+    return (e->moves[step >> 2] >> ((step & 3) * 2)) & 3;
+}
+
+static inline void vl_table_set_move(vl_table_entry_t *e, int step, int move) {
+    e->moves[step >> 2] |= (unsigned char)(move << ((step & 3) * 2));
+}
+
+#endif
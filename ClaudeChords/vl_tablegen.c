@@ -0,0 +1,130 @@
+// vl_tablegen - writes the precomputed voice-leading table (see vl_table.h)
+//
+// Usage: vl_tablegen <output file> [threads]
+//
+// Every canonical source set is one row of the table; worker threads
+// claim rows from a shared counter and pwrite() them straight into place.
+// The header goes in last and the file is renamed into position only when
+// complete, so a crashed or interrupted run never leaves a valid-looking
+// table.
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "voicelead.h"
+
+#define MAX_THREADS 64
+
+static int out_fd;
+static pcset_t next_set = 1;
+static short class_index[VL_TABLE_SETS + 1];
+static vl_modulus_t modulus;   // VL_TABLE_MODULUS lookups, shared read-only
+static pthread_mutex_t row_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Same search the externals run live (libvoicelead)
+static void compute_entry(vl_scratch_t *scratch,
+                          int *source, int source_size,
+                          int *target, int target_size,
+                          vl_table_entry_t *e) {
+    vl_path_t path;
+    vl_search(scratch, VL_METRIC_L1, &modulus, source, source_size, target, target_size, &path);
+
+    memset(e->moves, 0, sizeof(e->moves));
+    for (int step = 0; step < path.move_count; step++) {
+        vl_table_set_move(e, step, path.moves[step]);
+    }
+
+    e->cost = (unsigned char)path.cost;
+    e->rotation = (unsigned char)path.rotation;
+}
+
+static void *worker(void *arg) {
+    vl_table_entry_t *row = malloc(VL_TABLE_SETS * sizeof(vl_table_entry_t));
+    void *memory = malloc(VL_SCRATCH_BYTES(VL_MODULUS));
+    vl_arena_t arena;
+    vl_scratch_t scratch;
+    int source[VL_MODULUS], target[VL_MODULUS];
+
+    vl_arena_init(&arena, memory, VL_SCRATCH_BYTES(VL_MODULUS));
+    vl_scratch_init(&scratch, &arena, VL_MODULUS);
+
+    for (;;) {
+        pthread_mutex_lock(&row_lock);
+        while (next_set <= VL_TABLE_SETS && class_index[next_set] < 0) next_set++;
+        pcset_t source_set = next_set++;
+        pthread_mutex_unlock(&row_lock);
+        if (source_set > VL_TABLE_SETS) break;
+
+        int source_size = pcset_members(source_set, source);
+        for (pcset_t target_set = 1; target_set <= VL_TABLE_SETS; target_set++) {
+            int target_size = pcset_members(target_set, target);
+            compute_entry(&scratch, source, source_size, target, target_size,
+                          &row[target_set - 1]);
+        }
+
+        off_t offset = sizeof(vl_table_header_t) +
+                       (off_t)vl_table_index(class_index[source_set], 1) *
+                       sizeof(vl_table_entry_t);
+        if (pwrite(out_fd, row, VL_TABLE_SETS * sizeof(vl_table_entry_t), offset) < 0) {
+            perror("vl_tablegen: write");
+            exit(1);
+        }
+    }
+
+    free(memory);
+    free(row);
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <output file> [threads]\n", argv[0]);
+        return 1;
+    }
+
+    int threads = argc > 2 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", argv[1]);
+    out_fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) {
+        perror(tmp_path);
+        return 1;
+    }
+
+    vl_table_class_index(class_index);
+    vl_modulus_init(&modulus, VL_TABLE_MODULUS);
+    printf("vl_tablegen: %d x %d pairs on %d threads\n",
+           VL_TABLE_CLASSES, VL_TABLE_SETS, threads);
+
+    pthread_t pool[MAX_THREADS];
+    for (int t = 0; t < threads; t++) {
+        pthread_create(&pool[t], NULL, worker, NULL);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(pool[t], NULL);
+    }
+
+    vl_table_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VL_TABLE_MAGIC, 4);
+    header.version = VL_TABLE_VERSION;
+    header.modulus = VL_TABLE_MODULUS;
+    header.entry_size = sizeof(vl_table_entry_t);
+    header.set_count = VL_TABLE_SETS;
+    header.class_count = VL_TABLE_CLASSES;
+
+    if (pwrite(out_fd, &header, sizeof(header), 0) != sizeof(header) ||
+        close(out_fd) < 0 || rename(tmp_path, argv[1]) < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    printf("vl_tablegen: wrote %s\n", argv[1]);
+    return 0;
+}
@@ -0,0 +1,118 @@
+// Debug trace points that stay out of the calculation path
+//
+// A trace point copies a few ints into a per-instance ring buffer; no
+// formatting, no console I/O, no locks. The ring is single-producer /
+// single-consumer, so the producer may be the Pd thread or a worker. A
+// Pd clock drains it at idle priority and formats each record with the
+// external's own format table (vl_trace_drain).
+//
+// Build with -DVL_TRACE=0 and every VL_TRACE_EVENT compiles to nothing,
+// arguments included.
+
+#ifndef VL_TRACE_H
+#define VL_TRACE_H
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#ifndef VL_TRACE
+#define VL_TRACE 1
+#endif
+
+#define VL_TRACE_CAPACITY 256    // Records per instance (power of two)
+#define VL_TRACE_MAX_ARGS 6
+#define VL_TRACE_DRAIN_MS 50     // Drain period while debug is on
+#define VL_TRACE_DRAIN_BATCH 32  // Lines posted per drain at most
+
+typedef struct _vl_trace_record {
+    unsigned short event;   // Index into the external's format table
+    unsigned short argc;
+    int args[VL_TRACE_MAX_ARGS];
+} vl_trace_record_t;
+
+typedef struct _vl_trace {
+    vl_trace_record_t records[VL_TRACE_CAPACITY];
+    atomic_uint head;        // Next slot to write (producer)
+    atomic_uint tail;        // Next slot to read (consumer)
+    atomic_ulong dropped;    // Records lost to a full ring
+} vl_trace_t;
+
+static inline void vl_trace_init(vl_trace_t *t) {
+    atomic_init(&t->head, 0);
+    atomic_init(&t->tail, 0);
+    atomic_init(&t->dropped, 0);
+}
+
+// Producer side; drops the record rather than wait when the ring is full
+static inline void vl_trace_write(vl_trace_t *t, int event, int argc, const int *args) {
+    unsigned int head = atomic_load_explicit(&t->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&t->tail, memory_order_acquire);
+    if (head - tail >= VL_TRACE_CAPACITY) {
+        atomic_fetch_add_explicit(&t->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    vl_trace_record_t *r = &t->records[head & (VL_TRACE_CAPACITY - 1)];
+    r->event = (unsigned short)event;
+    r->argc = (unsigned short)(argc < VL_TRACE_MAX_ARGS ? argc : VL_TRACE_MAX_ARGS);
+    for (int i = 0; i < r->argc; i++) {
+        r->args[i] = args[i];
+    }
+    atomic_store_explicit(&t->head, head + 1, memory_order_release);
+}
+
+// Consumer side; returns 0 when empty
+static inline int vl_trace_read(vl_trace_t *t, vl_trace_record_t *record) {
+    unsigned int tail = atomic_load_explicit(&t->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&t->head, memory_order_acquire);
+    if (tail == head) return 0;
+
+    *record = t->records[tail & (VL_TRACE_CAPACITY - 1)];
+    atomic_store_explicit(&t->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+// printf a record through formats[event]; unused arguments are ignored
+static inline void vl_trace_format(const vl_trace_record_t *r, const char *const *formats,
+                                   char *line, size_t size) {
+    int a[VL_TRACE_MAX_ARGS] = { 0 };
+    for (int i = 0; i < r->argc; i++) {
+        a[i] = r->args[i];
+    }
+    snprintf(line, size, formats[r->event], a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+#if VL_TRACE
+// VL_TRACE_EVENT(&x->trace, x->debug_enabled, EVENT, int args...)
+#define VL_TRACE_EVENT(trace, enabled, event, ...) do { \
+    if (enabled) { \
+        const int vl_trace_args_[] = { __VA_ARGS__ }; \
+        vl_trace_write((trace), (event), \
+                       (int)(sizeof(vl_trace_args_) / sizeof(int)), vl_trace_args_); \
+    } \
+} while (0)
+#else
+#define VL_TRACE_EVENT(trace, enabled, event, ...) do { } while (0)
+#endif
+
+#ifdef PD_MAJOR_VERSION
+// Post up to VL_TRACE_DRAIN_BATCH records; returns nonzero if more remain
+static inline int vl_trace_drain(vl_trace_t *t, const char *const *formats,
+                                 const char *name) {
+    vl_trace_record_t record;
+    char line[MAXPDSTRING];
+
+    for (int n = 0; n < VL_TRACE_DRAIN_BATCH; n++) {
+        if (!vl_trace_read(t, &record)) break;
+        vl_trace_format(&record, formats, line, sizeof(line));
+        post("%s", line);
+    }
+
+    unsigned long dropped = atomic_exchange(&t->dropped, 0);
+    if (dropped) post("%s: trace buffer full, %lu records dropped", name, dropped);
+
+    return atomic_load(&t->head) != atomic_load(&t->tail);
+}
+#endif
+
+#endif
@@ -0,0 +1,165 @@
+// Background voice-leading searches - see vl_worker.h
+#include <string.h>
+#include "vl_worker.h"
+#include "vl_stats.h"
+
+static void vl_queue_clear(vl_queue_t *q) {
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+}
+
+// Producer side; the caller has already checked there is room
+static void vl_queue_push(vl_queue_t *q, const vl_job_t *job) {
+    unsigned int head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    q->jobs[head & (VL_WORKER_QUEUE - 1)] = *job;
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+}
+
+// Consumer side; returns 0 when empty
+static int vl_queue_pop(vl_queue_t *q, vl_job_t *job) {
+    unsigned int tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&q->head, memory_order_acquire);
+    if (tail == head) return 0;
+
+    *job = q->jobs[tail & (VL_WORKER_QUEUE - 1)];
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+static int vl_queue_empty(vl_queue_t *q) {
+    return atomic_load_explicit(&q->head, memory_order_acquire) ==
+           atomic_load_explicit(&q->tail, memory_order_relaxed);
+}
+
+// The same pipeline voice_leading runs inline
+static void vl_worker_run(vl_worker_t *w, vl_job_t *job) {
+    if (job->chain & VL_CHAIN_SOURCE) {
+        memcpy(job->source, w->last, w->last_size * sizeof(int));
+        job->source_size = w->last_size;
+    }
+    if (job->chain & VL_CHAIN_RNG) job->rng = w->rng;
+
+    unsigned long long start = vl_stats_now();
+    unsigned long hits = w->cache.hits + w->table.hits;
+    job->hit = 0;
+
+    if (job->voices > 0) {
+        // Voice i stays voice i, so there is no functional reordering
+        job->cost = vl_fixed_voices(&w->scratch, job->metric, job->modulus,
+                                    job->source, job->source_size,
+                                    job->target_pcs, job->target_size,
+                                    job->voices, job->budget, job->output, &job->nodes);
+        job->output_size = job->voices;
+        memcpy(job->functional, job->output, job->output_size * sizeof(int));
+        job->functional_size = job->output_size;
+    } else {
+        vl_context_t ctx;
+        ctx.table = w->table.entries ? &w->table : NULL;
+        ctx.cache = &w->cache;
+        ctx.scratch = &w->scratch;
+        ctx.topn = job->topn;
+        ctx.rng = &job->rng;
+        ctx.metric = job->metric;
+        ctx.modulus = job->modulus;
+
+        vl_pair_t vl[VL_MAX_PAIRS];
+        int vl_size;
+        job->cost = vl_nonbijective(&ctx, job->source, job->source_size,
+                                    job->target_pcs, job->target_size, vl, &vl_size);
+        job->output_size = vl_apply(job->modulus, job->source, job->source_size,
+                                    vl, vl_size, job->output);
+        job->functional_size = vl_reorder_by_function(job->modulus->modulus,
+                                                      job->output, job->output_size, job->root,
+                                                      job->structure, job->structure_size,
+                                                      job->functional);
+        job->hit = w->cache.hits + w->table.hits != hits;
+    }
+    job->elapsed_ns = vl_stats_now() - start;
+
+    memcpy(w->last, job->output, job->output_size * sizeof(int));
+    w->last_size = job->output_size;
+    w->rng = job->rng;
+}
+
+static void *vl_worker_main(void *arg) {
+    vl_worker_t *w = arg;
+    vl_job_t job;
+
+    while (atomic_load(&w->running)) {
+        pthread_mutex_lock(&w->mutex);
+        while (atomic_load(&w->running) && vl_queue_empty(&w->requests)) {
+            pthread_cond_wait(&w->wake, &w->mutex);
+        }
+        pthread_mutex_unlock(&w->mutex);
+
+        while (atomic_load(&w->running) && vl_queue_pop(&w->requests, &job)) {
+            vl_worker_run(w, &job);
+            vl_queue_push(&w->results, &job);
+            w->notify(w->owner);
+        }
+    }
+    return NULL;
+}
+
+int vl_worker_start(vl_worker_t *worker, const vl_table_t *table,
+                    const vl_scratch_t *scratch,
+                    void (*notify)(void *owner), void *owner) {
+    vl_queue_clear(&worker->requests);
+    vl_queue_clear(&worker->results);
+    worker->notify = notify;
+    worker->owner = owner;
+
+    if (table) {
+        worker->table = *table;
+        worker->table.hits = 0;
+    } else {
+        memset(&worker->table, 0, sizeof(worker->table));
+    }
+    vl_cache_clear(&worker->cache);
+    worker->scratch = *scratch;
+    worker->last_size = 0;
+    worker->rng = 0;
+
+    atomic_init(&worker->running, 1);
+    pthread_mutex_init(&worker->mutex, NULL);
+    pthread_cond_init(&worker->wake, NULL);
+    if (pthread_create(&worker->thread, NULL, vl_worker_main, worker) != 0) {
+        pthread_cond_destroy(&worker->wake);
+        pthread_mutex_destroy(&worker->mutex);
+        return -1;
+    }
+    return 0;
+}
+
+void vl_worker_stop(vl_worker_t *worker) {
+    pthread_mutex_lock(&worker->mutex);
+    atomic_store(&worker->running, 0);
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->mutex);
+
+    pthread_join(worker->thread, NULL);
+    pthread_cond_destroy(&worker->wake);
+    pthread_mutex_destroy(&worker->mutex);
+}
+
+int vl_worker_stopping(vl_worker_t *worker) {
+    return !atomic_load(&worker->running);
+}
+
+int vl_worker_submit(vl_worker_t *worker, const vl_job_t *job) {
+    // Submitted but not yet collected; bounds both queues
+    unsigned int in_flight = atomic_load_explicit(&worker->requests.head, memory_order_relaxed) -
+                             atomic_load_explicit(&worker->results.tail, memory_order_relaxed);
+    if (in_flight >= VL_WORKER_QUEUE) return -1;
+
+    vl_queue_push(&worker->requests, job);
+
+    pthread_mutex_lock(&worker->mutex);
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->mutex);
+    return 0;
+}
+
+int vl_worker_result(vl_worker_t *worker, vl_job_t *job) {
+    return vl_queue_pop(&worker->results, job);
+}
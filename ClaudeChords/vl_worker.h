@@ -0,0 +1,101 @@
+// Background voice-leading searches for an external
+//
+// One worker pthread per owner. The owner (the Pd thread) pushes jobs onto a
+// lock-free single-producer/single-consumer queue and the worker pushes
+// finished jobs onto a second one. The mutex is only held to wake an idle
+// worker, never while a search runs.
+// After each result the worker calls notify(owner) from its own thread; an
+// external schedules a clock there under sys_lock and drains the results
+// with vl_worker_result when it fires.
+//
+// The worker has its own cache, scratch and copy of the table handle (the
+// mapping itself is read-only and shared), so it never touches the
+// owner's search state. Like the rest of libvoicelead nothing here
+// allocates: the caller provides the vl_worker_t and the scratch memory.
+
+#ifndef VL_WORKER_H
+#define VL_WORKER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "voicelead.h"
+
+#define VL_WORKER_QUEUE 16   // Jobs in flight per worker (power of two)
+
+// With jobs still in flight the owner's copy of these is stale
+#define VL_CHAIN_SOURCE 1   // Source is the previous job's output (feedback)
+#define VL_CHAIN_RNG 2      // Continue the previous job's rng (topn)
+
+typedef struct _vl_job {
+    // Request
+    unsigned int sequence;
+    int chain;        // VL_CHAIN_* taken from the previous job instead
+    int source[VL_MAX_ENSEMBLE];
+    int source_size;
+    int target_pcs[VL_MAX_ENSEMBLE];
+    int target_size;
+    int root;         // For the functional order
+    int structure[VL_MAX_ENSEMBLE];
+    int structure_size;
+    int topn;
+    int metric;       // VL_METRIC_*
+    const vl_modulus_t *modulus;   // Owner's tables; must outlive the job
+    unsigned int rng;
+    int voices;       // > 0: vl_fixed_voices with this many voices
+    long budget;      // Its node budget
+    int stamp;        // Owner's latency stamp, passed back untouched
+
+    // Result
+    int cost;
+    int output[VL_MAX_ENSEMBLE];       // Voice-led order
+    int output_size;
+    int functional[VL_MAX_ENSEMBLE];   // Root, third, fifth, seventh
+    int functional_size;
+    long nodes;       // Fixed voices: search nodes spent
+    int hit;          // Answered from the worker's cache or the table
+    unsigned long long elapsed_ns;   // Time the search took on the worker
+} vl_job_t;
+
+typedef struct _vl_queue {
+    vl_job_t jobs[VL_WORKER_QUEUE];
+    atomic_uint head;   // Next slot to write (producer)
+    atomic_uint tail;   // Next slot to read (consumer)
+} vl_queue_t;
+
+typedef struct _vl_worker {
+    pthread_t thread;
+    pthread_mutex_t mutex;   // Only for sleeping on wake
+    pthread_cond_t wake;
+    atomic_int running;
+    vl_queue_t requests;     // Owner -> worker
+    vl_queue_t results;      // Worker -> owner
+    void (*notify)(void *owner);
+    void *owner;
+
+    // Worker-side search state
+    vl_table_t table;
+    vl_cache_t cache;
+    vl_scratch_t scratch;
+    int last[VL_MAX_ENSEMBLE];   // Output of the previous job, for chain
+    int last_size;
+    unsigned int rng;
+} vl_worker_t;
+
+// Start the thread; table may be NULL. scratch is the worker's alone
+// until it stops. Returns 0, or -1 if no thread.
+int vl_worker_start(vl_worker_t *worker, const vl_table_t *table,
+                    const vl_scratch_t *scratch,
+                    void (*notify)(void *owner), void *owner);
+
+// Stop and join; results not yet collected are lost
+void vl_worker_stop(vl_worker_t *worker);
+
+// Nonzero once vl_worker_stop has begun, so notify can give up waiting
+int vl_worker_stopping(vl_worker_t *worker);
+
+// Owner side: queue a job (0, or -1 when VL_WORKER_QUEUE are in flight)
+// and collect finished ones in order (1, or 0 when there are none)
+int vl_worker_submit(vl_worker_t *worker, const vl_job_t *job);
+int vl_worker_result(vl_worker_t *worker, vl_job_t *job);
+
+#endif
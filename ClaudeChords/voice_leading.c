@@ -1,16 +1,19 @@
 //
 // Created by Daniel Villegas on 2025-10-20.
 //
-#include <stdbool.h>
-#include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include "m_pd.h"
+#include "voicelead.h"
+#include "vl_trace.h"
+#include "vl_stats.h"
+#include "vl_worker.h"
+#include "vl_song.h"
 
-#define MAX_VOICES 8
-#define MAX_MATRIX_SIZE 16  // For dynamic programming matrix
-#define VERYLARGENUMBER 10000
-#define MODULUS 12
-#define HALFMODULUS 6
+#define MAX_VOICES VL_MAX_ENSEMBLE   // Array size; x->voices is the limit
+#define ROOT_OCTAVE 4   // The root outlet sends the root in this octave (MIDI 48 + root)
+#define VL_DEFAULT_SEED 0x9E3779B9u
 
 static t_class *voice_leading_class;
 
@@ -30,373 +33,139 @@ typedef struct _voice_leading {
     int feedback_enabled;
     int debug_enabled;
     int last_vl_cost;
+    int topn;                 // Choose among the N cheapest (1 = always best)
+    unsigned int rng_state;   // xorshift32 state for the topn choice
+    int metric;               // VL_METRIC_* the search minimizes
+    const vl_modulus_t *modulus;   // Lookup tables of the EDO in use ('modulus')
+    int voices;               // Most pitches per chord (creation argument)
+    vl_arena_t arena;         // Search memory for that many, allocated once in new()
+    vl_scratch_t scratch;     // Working memory for the live search
+    vl_scratch_t worker_scratch;   // Lent to the worker while 'async' is on
+    vl_trace_t trace;         // Debug records, posted by trace_clock
+    t_clock *trace_clock;
+    vl_worker_t *worker;      // Searches off the Pd thread, or NULL ('async')
+    t_clock *result_clock;    // Set by the worker, sends its results
+    unsigned int submitted;   // Jobs handed to the worker so far
+    unsigned int collected;   // Results sent so far
+    unsigned int current_after;   // 'current' arrived after this many jobs
+    unsigned int variation_after; // 'variation' arrived after this many jobs
+    int beam;                 // Paths kept per chord by 'progression' (0 = all)
+    int fixed_voices;         // > 0: always this many voices ('voices')
+    long fixed_budget;        // Search nodes per chord in that mode
+    vl_stats_t stats;         // Searches timed for 'stats'
+    int stamp;                // Latency stamp for the next chord, or 0 ('stamp')
 } t_voice_leading;
 
-typedef struct {
-    int source_note;
-    int target_note;
-} voice_pair_t;
-
-// Helper: calculate PC distance (min of both directions)
-static int pc_distance(int pc1, int pc2) {
-    int forward = (pc2 - pc1 + MODULUS) % MODULUS;
-    int backward = (pc1 - pc2 + MODULUS) % MODULUS;
-    return (forward < backward) ? forward : backward;
-}
-
-// Helper: remove duplicates and sort
-static int remove_duplicates_and_sort(int *input, int input_size, int *output) {
-    if (input_size == 0) return 0;
-
-    // Copy and sort
-    int temp[MAX_VOICES];
-    for (int i = 0; i < input_size; i++) {
-        temp[i] = input[i];
-    }
-
-    // Bubble sort
-    for (int i = 0; i < input_size - 1; i++) {
-        for (int j = i + 1; j < input_size; j++) {
-            if (temp[j] < temp[i]) {
-                int swap = temp[i];
-                temp[i] = temp[j];
-                temp[j] = swap;
-            }
-        }
-    }
-
-    // Remove duplicates
-    int out_size = 0;
-    output[out_size++] = temp[0];
-    for (int i = 1; i < input_size; i++) {
-        if (temp[i] != temp[i-1]) {
-            output[out_size++] = temp[i];
-        }
-    }
-
-    return out_size;
+// Trace events and how the drain clock formats them
+enum {
+    TRACE_START,
+    TRACE_TARGET_PCS,
+    TRACE_PAIR_COUNT,
+    TRACE_PAIR,
+    TRACE_VOICE_LED,
+    TRACE_FUNCTIONAL,
+    TRACE_COST,
+    TRACE_FEEDBACK,
+    TRACE_CURRENT_SET,
+    TRACE_ROOT_SET,
+    TRACE_CHORD_SET,
+    TRACE_CHORD_PCS,
+    TRACE_TARGET_SET,
+    TRACE_FIXED
+};
+
+static const char *const trace_formats[] = {
+    [TRACE_START] = "DEBUG: ===== Nonbijective Voice Leading ===== current [%d %d %d %d]",
+    [TRACE_TARGET_PCS] = "DEBUG: Target PCs: [%d %d %d %d]",
+    [TRACE_PAIR_COUNT] = "DEBUG: Found %d voice pairs",
+    [TRACE_PAIR] = "DEBUG:   [%d] %d -> %d",
+    [TRACE_VOICE_LED] = "DEBUG: Voice-led output: [%d %d %d %d]",
+    [TRACE_FUNCTIONAL] = "DEBUG: Functional output: [%d %d %d %d]",
+    [TRACE_COST] = "DEBUG: Voice leading cost: %d, root PC %d (MIDI note %d)",
+    [TRACE_FEEDBACK] = "DEBUG: Feedback enabled - updated current chord",
+    [TRACE_CURRENT_SET] = "voice_leading: current chord set to [%d %d %d %d]",
+    [TRACE_ROOT_SET] = "voice_leading: root set to %d",
+    [TRACE_CHORD_SET] = "voice_leading: chord structure [%d %d %d %d] + root %d",
+    [TRACE_CHORD_PCS] = "voice_leading:   = target PCs [%d %d %d %d]",
+    [TRACE_TARGET_SET] = "voice_leading: target set to [%d %d %d %d]",
+    [TRACE_FIXED] = "DEBUG: %d fixed voices, %d search nodes (budget spent: %d)"
+};
+
+#define TRACE(event, ...) VL_TRACE_EVENT(&x->trace, x->debug_enabled, event, __VA_ARGS__)
+
+// Shared by every instance of the class: the table is mapped once per
+// process, and a live set keeps cycling through the same few dozen chord
+// pairs, whichever object asks for them
+static vl_table_t vl_table;
+static vl_cache_t vl_cache;
+static vl_plan_cache_t vl_plan_cache;
+static vl_plan_t vl_plan;   // Working memory for 'progression'
+static vl_modulus_t *vl_moduli[VL_MAX_MODULUS + 1];   // Built on first use, kept for good
+
+// Lookup tables for n-EDO; in-flight worker jobs may still point at the
+// previous ones, so they are never freed
+static const vl_modulus_t *voice_leading_tables(int n) {
+    if (!vl_moduli[n]) {
+        vl_moduli[n] = (vl_modulus_t *)getbytes(sizeof(vl_modulus_t));
+        vl_modulus_init(vl_moduli[n], n);
+    }
+    return vl_moduli[n];
 }
 
-// Build the dynamic programming matrix
-static int build_matrix(t_voice_leading *x,
-                        int *source, int source_size,
-                        int *target, int target_size,
-                        int matrix[MAX_MATRIX_SIZE][MAX_MATRIX_SIZE],
-                        int output_matrix[MAX_MATRIX_SIZE][MAX_MATRIX_SIZE]) {
-
-    if (x->debug_enabled) {
-        post("DEBUG: Building matrix %dx%d", target_size, source_size);
-    }
-
-    // Initialize distance matrix
-    for (int i = 0; i < target_size; i++) {
-        for (int j = 0; j < source_size; j++) {
-            matrix[i][j] = pc_distance(source[j], target[i]);
-        }
-    }
-
-    // Initialize output matrix (copy distance matrix)
-    for (int i = 0; i < target_size; i++) {
-        for (int j = 0; j < source_size; j++) {
-            output_matrix[i][j] = matrix[i][j];
-        }
-    }
-
-    // Fill first row (cumulative)
-    for (int j = 1; j < source_size; j++) {
-        output_matrix[0][j] += output_matrix[0][j-1];
-    }
-
-    // Fill first column (cumulative)
-    for (int i = 1; i < target_size; i++) {
-        output_matrix[i][0] += output_matrix[i-1][0];
-    }
-
-    // Fill rest of matrix with minimum cumulative cost
-    for (int i = 1; i < target_size; i++) {
-        for (int j = 1; j < source_size; j++) {
-            int from_left = output_matrix[i][j-1];
-            int from_above = output_matrix[i-1][j];
-            int from_diagonal = output_matrix[i-1][j-1];
-
-            int min_cost = from_diagonal;
-            if (from_left < min_cost) min_cost = from_left;
-            if (from_above < min_cost) min_cost = from_above;
-
-            output_matrix[i][j] += min_cost;
-        }
-    }
-
-    // Return total cost (minus the last cell's own distance)
-    int total_cost = output_matrix[target_size-1][source_size-1] -
-                     matrix[target_size-1][source_size-1];
-
-    if (x->debug_enabled) {
-        post("DEBUG: Matrix total cost: %d", total_cost);
-    }
-
-    return total_cost;
-}
-
-// Backtrack through matrix to find voice leading
-static int find_matrix_vl(t_voice_leading *x,
-                          int *source, int source_size,
-                          int *target, int target_size,
-                          int output_matrix[MAX_MATRIX_SIZE][MAX_MATRIX_SIZE],
-                          voice_pair_t *vl) {
-
-    int i = target_size - 1;
-    int j = source_size - 1;
-    int vl_count = 0;
-
-    // Add final pairing
-    vl[vl_count].source_note = source[j];
-    vl[vl_count].target_note = target[i];
-    vl_count++;
-
-    // Backtrack through matrix
-    while (i > 0 || j > 0) {
-        int new_i = i;
-        int new_j = j;
-
-        if (i > 0 && j > 0) {
-            // Can move diagonally, left, or up - choose minimum
-            int diagonal = output_matrix[i-1][j-1];
-            int from_above = output_matrix[i-1][j];
-            int from_left = output_matrix[i][j-1];
-
-            int min_cost = diagonal;
-            new_i = i - 1;
-            new_j = j - 1;
-
-            if (from_above < min_cost) {
-                min_cost = from_above;
-                new_i = i - 1;
-                new_j = j;
-            }
-
-            if (from_left < min_cost) {
-                min_cost = from_left;
-                new_i = i;
-                new_j = j - 1;
-            }
-
-            i = new_i;
-            j = new_j;
-        } else if (i > 0) {
-            i = i - 1;
-        } else if (j > 0) {
-            j = j - 1;
-        }
-
-        vl[vl_count].source_note = source[j];
-        vl[vl_count].target_note = target[i];
-        vl_count++;
-    }
-
-    // Reverse the voice leading (we built it backwards)
-    for (int k = 0; k < vl_count / 2; k++) {
-        voice_pair_t temp = vl[k];
-        vl[k] = vl[vl_count - 1 - k];
-        vl[vl_count - 1 - k] = temp;
-    }
-
-    if (x->debug_enabled) {
-        post("DEBUG: Found %d voice pairs", vl_count);
-        for (int k = 0; k < vl_count; k++) {
-            post("DEBUG:   [%d] %d -> %d", k, vl[k].source_note, vl[k].target_note);
-        }
-    }
-
-    return vl_count;
-}
-
-// Nonbijective voice leading algorithm
-static void nonbijective_vl(t_voice_leading *x,
-                            int *source_pcs, int source_size,
-                            int *target_pcs, int target_size,
-                            voice_pair_t *best_vl, int *best_vl_size) {
-
-    // Remove duplicates and sort both sets
-    int unique_source[MAX_VOICES];
-    int unique_target[MAX_VOICES];
-    int unique_source_size = remove_duplicates_and_sort(source_pcs, source_size, unique_source);
-    int unique_target_size = remove_duplicates_and_sort(target_pcs, target_size, unique_target);
-
-    if (x->debug_enabled) {
-        post("DEBUG: Unique source size: %d, unique target size: %d",
-             unique_source_size, unique_target_size);
-    }
-
-    int best_cost = VERYLARGENUMBER;
-    voice_pair_t temp_vl[MAX_MATRIX_SIZE];
-    int matrix[MAX_MATRIX_SIZE][MAX_MATRIX_SIZE];
-    int output_matrix[MAX_MATRIX_SIZE][MAX_MATRIX_SIZE];
-
-    // Try all inversions of target
-    for (int inversion = 0; inversion < unique_target_size; inversion++) {
-        // Rotate target
-        int rotated_target[MAX_VOICES];
-        for (int i = 0; i < unique_target_size; i++) {
-            rotated_target[i] = unique_target[(i + inversion) % unique_target_size];
-        }
-
-        if (x->debug_enabled && inversion < 3) {
-            post("DEBUG: Trying inversion %d", inversion);
-        }
-
-        // Build matrix for this inversion
-        int cost = build_matrix(x, unique_source, unique_source_size,
-                               rotated_target, unique_target_size,
-                               matrix, output_matrix);
-
-        if (cost < best_cost) {
-            best_cost = cost;
-
-            // Find voice leading for this inversion
-            int vl_size = find_matrix_vl(x, unique_source, unique_source_size,
-                                        rotated_target, unique_target_size,
-                                        output_matrix, temp_vl);
-
-            // Copy to best
-            *best_vl_size = vl_size;
-            for (int i = 0; i < vl_size; i++) {
-                best_vl[i] = temp_vl[i];
-            }
-        }
+// Send a chord in functional order, then its root (n-EDO steps)
+static void voice_leading_output(t_voice_leading *x, const int *functional_output,
+                                 int functional_output_size, int root, int modulus) {
+    t_atom out_list[MAX_VOICES];
+    for (int i = 0; i < functional_output_size; i++) {
+        SETFLOAT(&out_list[i], functional_output[i]);
     }
 
-    x->last_vl_cost = best_cost;
-
-    if (x->debug_enabled) {
-        post("DEBUG: Best voice leading cost: %d", best_cost);
-    }
+    outlet_list(x->x_out_chord, &s_list, functional_output_size, out_list);
+    outlet_float(x->x_out_root, (t_float)(ROOT_OCTAVE * modulus + root));
 }
 
-// Apply voice leading to actual pitches
-static void apply_voice_leading(t_voice_leading *x,
-                                int *input_pitches, int input_size,
-                                voice_pair_t *vl, int vl_size,
-                                int *output_pitches, int *output_size) {
-
-    // Create a list of which input pitches are used
-    bool used[MAX_VOICES] = {false};
-    *output_size = 0;
-
-    // For each voice pair, find the closest input pitch with matching PC
-    for (int i = 0; i < vl_size; i++) {
-        int source_pc = vl[i].source_note % MODULUS;
-        int target_pc = vl[i].target_note % MODULUS;
-
-        // Find unused input pitch with matching source PC
-        int best_input_idx = -1;
-        int best_distance = VERYLARGENUMBER;
-
-        for (int j = 0; j < input_size; j++) {
-            if (used[j]) continue;
-
-            int pitch_pc = input_pitches[j] % MODULUS;
-            if (pitch_pc < 0) pitch_pc += MODULUS;
-
-            if (pitch_pc == source_pc) {
-                // Calculate distance to target
-                int distance = abs(input_pitches[j] - target_pc);
-                if (distance < best_distance) {
-                    best_distance = distance;
-                    best_input_idx = j;
-                }
-            }
-        }
-
-        if (best_input_idx >= 0) {
-            used[best_input_idx] = true;
-
-            // Calculate output pitch (keep it close to input)
-            int input_pitch = input_pitches[best_input_idx];
-            int output_pitch = input_pitch;
-
-            // Find nearest occurrence of target PC
-            int input_pc = input_pitch % MODULUS;
-            if (input_pc < 0) input_pc += MODULUS;
-
-            // Calculate path
-            int path = (target_pc - input_pc + MODULUS) % MODULUS;
-            if (path > HALFMODULUS) path -= MODULUS;
-
-            output_pitch = input_pitch + path;
-            output_pitches[*output_size] = output_pitch;
-            (*output_size)++;
-
-            if (x->debug_enabled) {
-                post("DEBUG: Voice %d: %d (PC %d) -> %d (PC %d)",
-                     i, input_pitch, input_pc, output_pitch, target_pc);
-            }
-        }
-    }
+// 'stamp <id>' on info right before a chord, for [latprobe mark]
+static void voice_leading_send_stamp(t_voice_leading *x, int stamp) {
+    if (!stamp) return;
+    t_atom id;
+    SETFLOAT(&id, stamp);
+    outlet_anything(x->x_out_info, gensym("stamp"), 1, &id);
 }
 
-// Reorder output by chord function (root, third, fifth, seventh)
-static void reorder_by_function(t_voice_leading *x,
-                                int *voice_led_chord, int voice_led_size,
-                                int *functional_output, int *functional_size) {
-
-    if (x->chord_structure_size == 0) {
-        // No chord structure defined, return as-is
-        memcpy(functional_output, voice_led_chord, voice_led_size * sizeof(int));
-        *functional_size = voice_led_size;
+// Hand the search to the worker; the result clock sends it
+static void voice_leading_submit(t_voice_leading *x) {
+    vl_job_t job;
+    job.sequence = x->submitted + 1;
+    // While jobs are in flight the next source (with feedback) and rng state
+    // are only known to the worker, unless 'current'/'variation' replaced them
+    int in_flight = x->submitted != x->collected;
+    job.chain = 0;
+    if (in_flight && x->feedback_enabled && x->current_after != x->submitted) {
+        job.chain |= VL_CHAIN_SOURCE;
+    }
+    if (in_flight && x->variation_after != x->submitted) job.chain |= VL_CHAIN_RNG;
+    memcpy(job.source, x->current_chord, sizeof(job.source));
+    job.source_size = x->current_size;
+    memcpy(job.target_pcs, x->chord_intervals, sizeof(job.target_pcs));
+    job.target_size = x->chord_size;
+    job.root = x->root_interval;
+    memcpy(job.structure, x->chord_structure, sizeof(job.structure));
+    job.structure_size = x->chord_structure_size;
+    job.topn = x->topn;
+    job.metric = x->metric;
+    job.modulus = x->modulus;
+    job.rng = x->rng_state;
+    job.voices = x->fixed_voices;
+    job.budget = x->fixed_budget;
+    job.stamp = x->stamp;
+    x->stamp = 0;
+
+    if (vl_worker_submit(x->worker, &job) != 0) {
+        pd_error(x, "voice_leading: %d searches already queued, chord dropped",
+                 VL_WORKER_QUEUE);
         return;
     }
-
-    // Map each chord structure interval to the lowest pitch that matches
-    int function_pitches[MAX_VOICES];
-    bool function_found[MAX_VOICES] = {false};
-
-    for (int i = 0; i < x->chord_structure_size; i++) {
-        function_pitches[i] = -1;  // -1 means not found yet
-    }
-
-    // For each output pitch, find which chord function it represents
-    for (int i = 0; i < voice_led_size; i++) {
-        int pitch = voice_led_chord[i];
-        int pc = pitch % MODULUS;
-        if (pc < 0) pc += MODULUS;
-
-        // Find which chord structure interval this matches
-        for (int j = 0; j < x->chord_structure_size; j++) {
-            int target_pc = (x->root_interval + x->chord_structure[j]) % MODULUS;
-            if (target_pc < 0) target_pc += MODULUS;
-
-            if (pc == target_pc) {
-                // This pitch matches this chord function
-                if (!function_found[j] || pitch < function_pitches[j]) {
-                    // Take the lowest occurrence of this function
-                    function_pitches[j] = pitch;
-                    function_found[j] = true;
-                }
-                break;
-            }
-        }
-    }
-
-    // Build output in functional order
-    *functional_size = 0;
-    for (int i = 0; i < x->chord_structure_size; i++) {
-        if (function_found[i]) {
-            functional_output[*functional_size] = function_pitches[i];
-            (*functional_size)++;
-        }
-    }
-
-    if (x->debug_enabled) {
-        post("DEBUG: Reordered by function:");
-        const char* function_names[] = {"root", "third", "fifth", "seventh"};
-        for (int i = 0; i < *functional_size; i++) {
-            int func_idx = (i < 4) ? i : 3;
-            post("DEBUG:   [%s] = %d",
-                 (i < x->chord_structure_size) ? function_names[i] : "extra",
-                 functional_output[i]);
-        }
-    }
+    x->submitted++;
 }
 
 // Main calculation function
@@ -407,85 +176,151 @@ static void voice_leading_calculate(t_voice_leading *x) {
         return;
     }
 
-    if (x->debug_enabled) {
-        post("\nDEBUG: ===== Starting Nonbijective Voice Leading =====");
-        post("DEBUG: Current chord: [%d %d %d %d]",
-             x->current_chord[0], x->current_chord[1],
-             x->current_chord[2], x->current_chord[3]);
-        post("DEBUG: Target PCs: [%d %d %d %d]",
-             x->chord_intervals[0], x->chord_intervals[1],
-             x->chord_intervals[2], x->chord_intervals[3]);
-    }
+    TRACE(TRACE_START, x->current_chord[0], x->current_chord[1],
+          x->current_chord[2], x->current_chord[3]);
+    TRACE(TRACE_TARGET_PCS, x->chord_intervals[0], x->chord_intervals[1],
+          x->chord_intervals[2], x->chord_intervals[3]);
 
-    // Convert current chord to PCs
-    int source_pcs[MAX_VOICES];
-    for (int i = 0; i < x->current_size; i++) {
-        source_pcs[i] = x->current_chord[i] % MODULUS;
-        if (source_pcs[i] < 0) source_pcs[i] += MODULUS;
+    if (x->worker) {
+        voice_leading_submit(x);
+        return;
     }
 
-    // Find optimal voice leading using nonbijective algorithm
-    voice_pair_t best_vl[MAX_MATRIX_SIZE];
-    int best_vl_size;
-
-    nonbijective_vl(x, source_pcs, x->current_size,
-                    x->chord_intervals, x->chord_size,
-                    best_vl, &best_vl_size);
-
-    // Apply voice leading to actual pitches
+    unsigned long long start = vl_stats_now();
+    unsigned long hits = vl_cache.hits + vl_table.hits;
     int output_chord[MAX_VOICES];
     int output_chord_size;
-
-    apply_voice_leading(x, x->current_chord, x->current_size,
-                       best_vl, best_vl_size,
-                       output_chord, &output_chord_size);
-
-    // Reorder output by chord function (root, third, fifth, seventh)
     int functional_output[MAX_VOICES];
     int functional_output_size;
-    reorder_by_function(x, output_chord, output_chord_size,
-                       functional_output, &functional_output_size);
-
-    if (x->debug_enabled) {
-        post("DEBUG: Voice-led output: [%d %d %d %d]",
-             output_chord_size > 0 ? output_chord[0] : 0,
-             output_chord_size > 1 ? output_chord[1] : 0,
-             output_chord_size > 2 ? output_chord[2] : 0,
-             output_chord_size > 3 ? output_chord[3] : 0);
-        post("DEBUG: Functional output: [%d %d %d %d]",
-             functional_output_size > 0 ? functional_output[0] : 0,
-             functional_output_size > 1 ? functional_output[1] : 0,
-             functional_output_size > 2 ? functional_output[2] : 0,
-             functional_output_size > 3 ? functional_output[3] : 0);
-        post("DEBUG: Voice leading cost: %d", x->last_vl_cost);
-        post("DEBUG: Root PC: %d (MIDI note: %d)",
-             x->root_interval, 48 + x->root_interval);
-    }
-
-    // Output results (functional order)
-    t_atom out_list[MAX_VOICES];
-    for (int i = 0; i < functional_output_size; i++) {
-        SETFLOAT(&out_list[i], functional_output[i]);
-    }
 
-    outlet_list(x->x_out_chord, &s_list, functional_output_size, out_list);
-    outlet_float(x->x_out_root, (t_float)(48 + x->root_interval));
+    if (x->fixed_voices > 0) {
+        // Voice i stays voice i, so the output keeps voice order
+        long nodes;
+        x->last_vl_cost = vl_fixed_voices(&x->scratch, x->metric, x->modulus,
+                                          x->current_chord, x->current_size,
+                                          x->chord_intervals, x->chord_size,
+                                          x->fixed_voices, x->fixed_budget,
+                                          output_chord, &nodes);
+        output_chord_size = x->fixed_voices;
+        memcpy(functional_output, output_chord, output_chord_size * sizeof(int));
+        functional_output_size = output_chord_size;
+
+        TRACE(TRACE_FIXED, x->fixed_voices, (int)nodes, nodes > x->fixed_budget);
+    } else {
+        // Find optimal voice leading using nonbijective algorithm
+        // (pitches reduce to pitch-class sets inside)
+        vl_context_t ctx;
+        ctx.table = &vl_table;
+        ctx.cache = &vl_cache;
+        ctx.scratch = &x->scratch;
+        ctx.topn = x->topn;
+        ctx.rng = &x->rng_state;
+        ctx.metric = x->metric;
+        ctx.modulus = x->modulus;
+
+        vl_pair_t best_vl[VL_MAX_PAIRS];
+        int best_vl_size;
+        x->last_vl_cost = vl_nonbijective(&ctx, x->current_chord, x->current_size,
+                                          x->chord_intervals, x->chord_size,
+                                          best_vl, &best_vl_size);
+
+        TRACE(TRACE_PAIR_COUNT, best_vl_size);
+        for (int k = 0; k < best_vl_size; k++) {
+            TRACE(TRACE_PAIR, k, best_vl[k].source_note, best_vl[k].target_note);
+        }
+
+        // Apply voice leading to actual pitches
+        output_chord_size = vl_apply(x->modulus, x->current_chord, x->current_size,
+                                     best_vl, best_vl_size, output_chord);
+
+        // Reorder output by chord function (root, third, fifth, seventh)
+        functional_output_size = vl_reorder_by_function(
+            x->modulus->modulus, output_chord, output_chord_size, x->root_interval,
+            x->chord_structure, x->chord_structure_size, functional_output);
+    }
+
+    TRACE(TRACE_VOICE_LED,
+          output_chord_size > 0 ? output_chord[0] : 0,
+          output_chord_size > 1 ? output_chord[1] : 0,
+          output_chord_size > 2 ? output_chord[2] : 0,
+          output_chord_size > 3 ? output_chord[3] : 0);
+    TRACE(TRACE_FUNCTIONAL,
+          functional_output_size > 0 ? functional_output[0] : 0,
+          functional_output_size > 1 ? functional_output[1] : 0,
+          functional_output_size > 2 ? functional_output[2] : 0,
+          functional_output_size > 3 ? functional_output[3] : 0);
+    int n = x->modulus->modulus;
+    TRACE(TRACE_COST, x->last_vl_cost, x->root_interval, ROOT_OCTAVE * n + x->root_interval);
+
+    vl_stats_add(&x->stats, vl_stats_now() - start, vl_cache.hits + vl_table.hits != hits,
+                 x->last_vl_cost);
+    voice_leading_send_stamp(x, x->stamp);
+    x->stamp = 0;
+    voice_leading_output(x, functional_output, functional_output_size, x->root_interval, n);
 
     if (x->feedback_enabled) {
         // Store the voice-led output (not functional order) for next iteration
         memcpy(x->current_chord, output_chord, output_chord_size * sizeof(int));
         x->current_size = output_chord_size;
 
-        if (x->debug_enabled) {
-            post("DEBUG: Feedback enabled - updated current chord");
+        TRACE(TRACE_FEEDBACK, 0);
+    }
+}
+
+// Result clock: send whatever the worker has finished, in order
+static void voice_leading_results_tick(t_voice_leading *x) {
+    vl_job_t job;
+    while (x->worker && vl_worker_result(x->worker, &job)) {
+        x->collected++;
+        x->last_vl_cost = job.cost;
+        vl_stats_add(&x->stats, job.elapsed_ns, job.hit, job.cost);
+        if (job.sequence > x->variation_after) x->rng_state = job.rng;
+
+        TRACE(TRACE_FUNCTIONAL,
+              job.functional_size > 0 ? job.functional[0] : 0,
+              job.functional_size > 1 ? job.functional[1] : 0,
+              job.functional_size > 2 ? job.functional[2] : 0,
+              job.functional_size > 3 ? job.functional[3] : 0);
+        int n = job.modulus->modulus;
+        TRACE(TRACE_COST, job.cost, job.root, ROOT_OCTAVE * n + job.root);
+
+        voice_leading_send_stamp(x, job.stamp);
+        voice_leading_output(x, job.functional, job.functional_size, job.root, n);
+
+        // A 'current' sent while this job was queued wins over its output
+        if (x->feedback_enabled && job.sequence > x->current_after) {
+            memcpy(x->current_chord, job.output, job.output_size * sizeof(int));
+            x->current_size = job.output_size;
+            TRACE(TRACE_FEEDBACK, 0);
         }
     }
 }
 
+// Worker thread: wake the result clock. sys_trylock returns 0 once it holds
+// the lock; polling rather than blocking lets free() join this thread
+// while it holds the lock itself.
+static void voice_leading_worker_notify(void *owner) {
+    t_voice_leading *x = owner;
+    while (sys_trylock() != 0) {
+        if (vl_worker_stopping(x->worker)) return;
+        usleep(100);
+    }
+    clock_delay(x->result_clock, 0);
+    sys_unlock();
+}
+
+static void voice_leading_worker_stop(t_voice_leading *x) {
+    if (!x->worker) return;
+    vl_worker_stop(x->worker);
+    freebytes(x->worker, sizeof(vl_worker_t));
+    x->worker = NULL;
+    x->collected = x->submitted;   // Whatever was in flight is gone
+}
+
 // Set current chord (COLD)
 static void voice_leading_current(t_voice_leading *x, t_symbol *s, int argc, t_atom *argv) {
-    if (argc > MAX_VOICES) {
-        pd_error(x, "voice_leading: too many voices (max %d)", MAX_VOICES);
+    if (argc > x->voices) {
+        pd_error(x, "voice_leading: too many voices (max %d)", x->voices);
         return;
     }
 
@@ -493,31 +328,27 @@ static void voice_leading_current(t_voice_leading *x, t_symbol *s, int argc, t_a
     for (int i = 0; i < argc; i++) {
         x->current_chord[i] = (int)atom_getfloat(&argv[i]);
     }
+    x->current_after = x->submitted;
 
-    if (x->debug_enabled) {
-        post("voice_leading: current chord set to [%d %d %d %d]",
-             argc > 0 ? x->current_chord[0] : 0,
-             argc > 1 ? x->current_chord[1] : 0,
-             argc > 2 ? x->current_chord[2] : 0,
-             argc > 3 ? x->current_chord[3] : 0);
-    }
+    TRACE(TRACE_CURRENT_SET,
+          argc > 0 ? x->current_chord[0] : 0,
+          argc > 1 ? x->current_chord[1] : 0,
+          argc > 2 ? x->current_chord[2] : 0,
+          argc > 3 ? x->current_chord[3] : 0);
 }
 
 // Set root interval (COLD)
 static void voice_leading_root(t_voice_leading *x, t_floatarg f) {
-    int root = (int)f % 12;
-    if (root < 0) root += 12;
+    int root = pc_mod((int)f, x->modulus->modulus);
     x->root_interval = root;
 
-    if (x->debug_enabled) {
-        post("voice_leading: root set to %d", x->root_interval);
-    }
+    TRACE(TRACE_ROOT_SET, x->root_interval);
 }
 
 // Set chord structure as intervals from root (HOT)
 static void voice_leading_chord(t_voice_leading *x, t_symbol *s, int argc, t_atom *argv) {
-    if (argc > MAX_VOICES) {
-        pd_error(x, "voice_leading: too many chord intervals (max %d)", MAX_VOICES);
+    if (argc > x->voices) {
+        pd_error(x, "voice_leading: too many chord intervals (max %d)", x->voices);
         return;
     }
 
@@ -528,24 +359,21 @@ static void voice_leading_chord(t_voice_leading *x, t_symbol *s, int argc, t_ato
 
     x->chord_size = argc;
     for (int i = 0; i < argc; i++) {
-        int target_pc = (x->root_interval + x->chord_structure[i]) % 12;
-        if (target_pc < 0) target_pc += 12;
+        int target_pc = pc_mod(x->root_interval + x->chord_structure[i], x->modulus->modulus);
         x->chord_intervals[i] = target_pc;
     }
 
-    if (x->debug_enabled) {
-        post("voice_leading: chord structure [%d %d %d %d] + root %d",
-             argc > 0 ? x->chord_structure[0] : 0,
-             argc > 1 ? x->chord_structure[1] : 0,
-             argc > 2 ? x->chord_structure[2] : 0,
-             argc > 3 ? x->chord_structure[3] : 0,
-             x->root_interval);
-        post("voice_leading:   = target PCs [%d %d %d %d]",
-             argc > 0 ? x->chord_intervals[0] : 0,
-             argc > 1 ? x->chord_intervals[1] : 0,
-             argc > 2 ? x->chord_intervals[2] : 0,
-             argc > 3 ? x->chord_intervals[3] : 0);
-    }
+    TRACE(TRACE_CHORD_SET,
+          argc > 0 ? x->chord_structure[0] : 0,
+          argc > 1 ? x->chord_structure[1] : 0,
+          argc > 2 ? x->chord_structure[2] : 0,
+          argc > 3 ? x->chord_structure[3] : 0,
+          x->root_interval);
+    TRACE(TRACE_CHORD_PCS,
+          argc > 0 ? x->chord_intervals[0] : 0,
+          argc > 1 ? x->chord_intervals[1] : 0,
+          argc > 2 ? x->chord_intervals[2] : 0,
+          argc > 3 ? x->chord_intervals[3] : 0);
 
     if (x->current_size > 0) {
         voice_leading_calculate(x);
@@ -556,23 +384,22 @@ static void voice_leading_chord(t_voice_leading *x, t_symbol *s, int argc, t_ato
 
 // Set target chord intervals (HOT)
 static void voice_leading_target(t_voice_leading *x, t_symbol *s, int argc, t_atom *argv) {
-    if (argc > MAX_VOICES) {
-        pd_error(x, "voice_leading: too many chord intervals (max %d)", MAX_VOICES);
+    if (argc > x->voices) {
+        pd_error(x, "voice_leading: too many chord intervals (max %d)", x->voices);
         return;
     }
 
     x->chord_size = argc;
     for (int i = 0; i < argc; i++) {
-        x->chord_intervals[i] = (int)atom_getfloat(&argv[i]);
+        int target_pc = pc_mod((int)atom_getfloat(&argv[i]), x->modulus->modulus);
+        x->chord_intervals[i] = target_pc;
     }
 
-    if (x->debug_enabled) {
-        post("voice_leading: target set to [%d %d %d %d]",
-             argc > 0 ? x->chord_intervals[0] : 0,
-             argc > 1 ? x->chord_intervals[1] : 0,
-             argc > 2 ? x->chord_intervals[2] : 0,
-             argc > 3 ? x->chord_intervals[3] : 0);
-    }
+    TRACE(TRACE_TARGET_SET,
+          argc > 0 ? x->chord_intervals[0] : 0,
+          argc > 1 ? x->chord_intervals[1] : 0,
+          argc > 2 ? x->chord_intervals[2] : 0,
+          argc > 3 ? x->chord_intervals[3] : 0);
 
     if (x->current_size > 0) {
         voice_leading_calculate(x);
@@ -587,10 +414,234 @@ static void voice_leading_feedback(t_voice_leading *x, t_floatarg f) {
     post("voice_leading: feedback %s", x->feedback_enabled ? "enabled" : "disabled");
 }
 
+// Post queued trace records; keeps ticking while debug is on or records remain
+static void voice_leading_trace_tick(t_voice_leading *x) {
+    if (vl_trace_drain(&x->trace, trace_formats, "voice_leading") || x->debug_enabled) {
+        clock_delay(x->trace_clock, VL_TRACE_DRAIN_MS);
+    }
+}
+
 // Toggle debug
 static void voice_leading_debug(t_voice_leading *x, t_floatarg f) {
     x->debug_enabled = (f != 0);
     post("voice_leading: debug %s", x->debug_enabled ? "enabled" : "disabled");
+    if (x->debug_enabled) clock_delay(x->trace_clock, VL_TRACE_DRAIN_MS);
+}
+
+// Report (or clear) the shared voice-leading cache
+static void voice_leading_cache(t_voice_leading *x, t_symbol *s, int argc, t_atom *argv) {
+    if (argc > 0 && atom_getsymbol(&argv[0]) == gensym("clear")) {
+        vl_cache_clear(&vl_cache);
+        vl_table.hits = 0;
+        post("voice_leading: cache cleared");
+        return;
+    }
+
+    t_atom info[6];
+    SETFLOAT(&info[0], (t_float)vl_cache.hits);
+    SETFLOAT(&info[1], (t_float)vl_cache.misses);
+    SETFLOAT(&info[2], (t_float)vl_cache.evictions);
+    SETFLOAT(&info[3], (t_float)vl_cache.count);
+    SETFLOAT(&info[4], (t_float)VL_CACHE_CAPACITY);
+    SETFLOAT(&info[5], (t_float)vl_table.hits);
+    outlet_anything(x->x_out_info, gensym("cache"), 6, info);
+}
+
+// Search count and times (the worker's own time with 'async');
+// 'stats reset' clears them
+static void voice_leading_stats(t_voice_leading *x, t_symbol *s, int argc, t_atom *argv) {
+    if (argc > 0 && atom_getsymbol(&argv[0]) == gensym("reset")) {
+        vl_stats_reset(&x->stats);
+        post("voice_leading: stats reset");
+        return;
+    }
+    vl_stats_output(&x->stats, x->x_out_info);
+}
+
+// Choose among the N cheapest voice leadings (1 = always the best)
+static void voice_leading_topn(t_voice_leading *x, t_floatarg f) {
+    int n = (int)f;
+    if (n < 1) n = 1;
+    if (n > VL_TOPN_MAX) n = VL_TOPN_MAX;
+    x->topn = n;
+
+    t_atom info;
+    SETFLOAT(&info, x->topn);
+    outlet_anything(x->x_out_info, gensym("topn"), 1, &info);
+}
+
+// Distance the search minimizes: l1 (total motion), l2 (sum of squares)
+// or linf (largest move). The table only holds l1 answers, so the others
+// always search live; the cache keeps each metric's answers apart.
+static void voice_leading_metric(t_voice_leading *x, t_symbol *s) {
+    if (s != &s_) {
+        vl_metric_t metric;
+        vl_metric_default(&metric);
+        if (vl_metric_set(&metric, s->s_name, NULL, 0) != 0) {
+            pd_error(x, "voice_leading: unknown metric '%s' (l1|l2|linf)", s->s_name);
+            return;
+        }
+        if (metric.kind == VL_METRIC_WEIGHTED) {
+            pd_error(x, "voice_leading: pitch classes have no voice order to weight "
+                     "(use orbifold or hungarian)");
+            return;
+        }
+        x->metric = metric.kind;
+    }
+
+    t_atom info;
+    SETSYMBOL(&info, gensym(vl_metric_names[x->metric]));
+    outlet_anything(x->x_out_info, gensym("metric"), 1, &info);
+}
+
+// Equal divisions of the octave (12 by default), e.g. 19, 24 or 31 for
+// microtonal patches: pitches become n-EDO steps and PCs run 0..n-1. Only
+// 12-EDO has the precomputed table; other moduli search live and cache.
+static void voice_leading_modulus(t_voice_leading *x, t_floatarg f) {
+    int n = (int)f;
+    if (n != 0) {
+        if (n < 2 || n > VL_MAX_MODULUS) {
+            pd_error(x, "voice_leading: modulus must be 2..%d", VL_MAX_MODULUS);
+            return;
+        }
+        x->modulus = voice_leading_tables(n);
+
+        // Stored pitch classes follow
+        x->root_interval = pc_mod(x->root_interval, n);
+        for (int i = 0; i < x->chord_size; i++) {
+            x->chord_intervals[i] = pc_mod(x->chord_intervals[i], n);
+        }
+    }
+
+    t_atom info;
+    SETFLOAT(&info, x->modulus->modulus);
+    outlet_anything(x->x_out_info, gensym("modulus"), 1, &info);
+}
+
+// Tag the next chord with a [latprobe stamp] id (COLD); it comes back as
+// 'stamp <id>' on info just before that chord, after the worker with 'async'
+static void voice_leading_stamp(t_voice_leading *x, t_floatarg f) {
+    x->stamp = f > 0 ? (int)f : 0;
+}
+
+// Reseed the topn choice so a performance can be replayed exactly
+static void voice_leading_variation(t_voice_leading *x, t_floatarg f) {
+    unsigned int seed = (unsigned int)f;
+    x->rng_state = seed ? seed : VL_DEFAULT_SEED;   // xorshift sticks at 0
+    x->variation_after = x->submitted;
+}
+
+// Voice a whole chord sequence at once: the candidate voicings of every
+// chord that minimize the total motion from the current chord, rather than
+// the cheapest next step each time. Chords are names as in the song files
+// (C, Am, F#m7, Bbmaj7, Gsus...). Sends each voicing in turn like a single
+// chord, then 'progression <total cost> <chords>' on info.
+static void voice_leading_progression(t_voice_leading *x, t_symbol *s, int argc, t_atom *argv) {
+    static vl_chord_t chords[VL_SONG_MAX_CHORDS];
+
+    if (x->current_size == 0) {
+        pd_error(x, "voice_leading: no current chord set");
+        return;
+    }
+    if (x->current_size > VL_MAX_VOICES) {
+        pd_error(x, "voice_leading: progression plans at most %d voices", VL_MAX_VOICES);
+        return;
+    }
+    if (x->modulus->modulus != VL_MODULUS) {
+        pd_error(x, "voice_leading: progression chord names are 12-EDO (modulus is %d)",
+                 x->modulus->modulus);
+        return;
+    }
+    if (argc > VL_SONG_MAX_CHORDS) {
+        pd_error(x, "voice_leading: progression too long (max %d chords)", VL_SONG_MAX_CHORDS);
+        return;
+    }
+
+    for (int i = 0; i < argc; i++) {
+        char name[VL_SONG_NAME_LENGTH];
+        atom_string(&argv[i], name, sizeof(name));
+        if (vl_chord_parse(name, &chords[i]) != 0) {
+            pd_error(x, "voice_leading: unknown chord '%s' in progression", name);
+            return;
+        }
+    }
+
+    int total = vl_plan_chords(&vl_plan_cache, chords, argc, x->current_chord,
+                               x->current_size, x->beam, &vl_plan);
+
+    for (int i = 0; i < argc; i++) {
+        int functional_output[MAX_VOICES];
+        int functional_output_size = vl_reorder_by_function(
+            VL_MODULUS, vl_plan.bars[i].notes, vl_plan.voices, chords[i].root,
+            chords[i].intervals, chords[i].size, functional_output);
+        voice_leading_output(x, functional_output, functional_output_size, chords[i].root,
+                             VL_MODULUS);
+    }
+
+    if (x->feedback_enabled && argc > 0) {
+        memcpy(x->current_chord, vl_plan.bars[argc - 1].notes, vl_plan.voices * sizeof(int));
+        x->current_size = vl_plan.voices;
+    }
+
+    t_atom info[2];
+    SETFLOAT(&info[0], total);
+    SETFLOAT(&info[1], argc);
+    outlet_anything(x->x_out_info, gensym("progression"), 2, info);
+}
+
+// Paths 'progression' keeps after each chord (0 = exact)
+static void voice_leading_beam(t_voice_leading *x, t_floatarg f) {
+    x->beam = f < 0 ? 0 : (int)f;
+
+    t_atom info;
+    SETFLOAT(&info, x->beam);
+    outlet_anything(x->x_out_info, gensym("beam"), 1, &info);
+}
+
+// Always N voices (0: as many as the nonbijective answer needs, the
+// default): the cheapest N-voice leading onto the target, doubling or
+// omitting chord tones, in voice order so voice i can stay on one synth.
+// A current chord of another size is doubled or trimmed to N first. The
+// optional second argument is the search budget in nodes; past it the
+// chord falls back to a greedy cover rather than overrun the block.
+static void voice_leading_voices(t_voice_leading *x, t_symbol *s, int argc, t_atom *argv) {
+    if (argc > 0) {
+        int n = (int)atom_getfloat(&argv[0]);
+        if (n < 0 || n > x->voices) {
+            pd_error(x, "voice_leading: voices must be 0..%d", x->voices);
+            return;
+        }
+        x->fixed_voices = n;
+    }
+    if (argc > 1) {
+        long budget = (long)atom_getfloat(&argv[1]);
+        x->fixed_budget = budget > 0 ? budget : VL_FIXED_BUDGET;
+    }
+
+    t_atom info[2];
+    SETFLOAT(&info[0], x->fixed_voices);
+    SETFLOAT(&info[1], (t_float)x->fixed_budget);
+    outlet_anything(x->x_out_info, gensym("voices"), 2, info);
+}
+
+// Run searches on a worker thread (1) or in the message handler (0);
+// results then arrive from the scheduler rather than synchronously
+static void voice_leading_async(t_voice_leading *x, t_floatarg f) {
+    if (f != 0 && !x->worker) {
+        x->worker = (vl_worker_t *)getbytes(sizeof(vl_worker_t));
+        if (vl_worker_start(x->worker, &vl_table, &x->worker_scratch,
+                                       voice_leading_worker_notify, x) != 0) {
+            pd_error(x, "voice_leading: could not start worker thread");
+            freebytes(x->worker, sizeof(vl_worker_t));
+            x->worker = NULL;
+        }
+    } else if (f == 0) {
+        voice_leading_worker_stop(x);
+    }
+
+    t_atom info;
+    SETFLOAT(&info, x->worker != NULL);
+    outlet_anything(x->x_out_info, gensym("async"), 1, &info);
 }
 
 // Bang
@@ -598,10 +649,23 @@ static void voice_leading_bang(t_voice_leading *x) {
     voice_leading_calculate(x);
 }
 
-// Constructor
-static void *voice_leading_new(void) {
+// Constructor: [voice_leading <voices>], 8 by default
+static void *voice_leading_new(t_floatarg f) {
     t_voice_leading *x = (t_voice_leading *)pd_new(voice_leading_class);
 
+    x->voices = f > 0 ? (int)f : VL_MAX_VOICES;
+    if (x->voices > VL_MAX_ENSEMBLE) {
+        pd_error(x, "voice_leading: at most %d voices", VL_MAX_ENSEMBLE);
+        x->voices = VL_MAX_ENSEMBLE;
+    }
+
+    // Every search from here on runs in these two scratches; nothing is
+    // allocated per chord
+    size_t arena_bytes = 2 * VL_SCRATCH_BYTES(x->voices);
+    vl_arena_init(&x->arena, getbytes(arena_bytes), arena_bytes);
+    vl_scratch_init(&x->scratch, &x->arena, x->voices);
+    vl_scratch_init(&x->worker_scratch, &x->arena, x->voices);
+
     x->x_out_info = outlet_new(&x->x_obj, &s_list);
     x->x_out_chord = outlet_new(&x->x_obj, &s_list);
     x->x_out_root = outlet_new(&x->x_obj, &s_float);
@@ -613,6 +677,23 @@ static void *voice_leading_new(void) {
     x->feedback_enabled = 1;
     x->debug_enabled = 0;
     x->last_vl_cost = 0;
+    x->topn = 1;
+    x->rng_state = VL_DEFAULT_SEED;
+    x->metric = VL_METRIC_L1;
+    x->modulus = voice_leading_tables(VL_MODULUS);
+    vl_trace_init(&x->trace);
+    vl_stats_reset(&x->stats);
+    x->stamp = 0;
+    x->trace_clock = clock_new(x, (t_method)voice_leading_trace_tick);
+    x->worker = NULL;
+    x->result_clock = clock_new(x, (t_method)voice_leading_results_tick);
+    x->submitted = 0;
+    x->collected = 0;
+    x->current_after = 0;
+    x->variation_after = 0;
+    x->beam = 0;
+    x->fixed_voices = 0;
+    x->fixed_budget = VL_FIXED_BUDGET;
 
     memset(x->current_chord, 0, MAX_VOICES * sizeof(int));
     memset(x->chord_structure, 0, MAX_VOICES * sizeof(int));
@@ -627,14 +708,22 @@ static void *voice_leading_new(void) {
     return (void *)x;
 }
 
+// Destructor
+static void voice_leading_free(t_voice_leading *x) {
+    voice_leading_worker_stop(x);
+    clock_free(x->result_clock);
+    clock_free(x->trace_clock);
+    freebytes(x->arena.base, x->arena.size);
+}
+
 // Setup
 void voice_leading_setup(void) {
     voice_leading_class = class_new(gensym("voice_leading"),
-                                    (t_newmethod)voice_leading_new,
-                                    0,
+                                    (t_newmethod)(t_method)voice_leading_new,
+                                    (t_method)voice_leading_free,
                                     sizeof(t_voice_leading),
                                     CLASS_DEFAULT,
-                                    0);
+                                    A_DEFFLOAT, 0);
 
     class_addmethod(voice_leading_class, (t_method)voice_leading_current,
                     gensym("current"), A_GIMME, 0);
@@ -648,15 +737,66 @@ void voice_leading_setup(void) {
                     gensym("feedback"), A_FLOAT, 0);
     class_addmethod(voice_leading_class, (t_method)voice_leading_debug,
                     gensym("debug"), A_FLOAT, 0);
+    class_addmethod(voice_leading_class, (t_method)voice_leading_cache,
+                    gensym("cache"), A_GIMME, 0);
+    class_addmethod(voice_leading_class, (t_method)voice_leading_stats,
+                    gensym("stats"), A_GIMME, 0);
+    class_addmethod(voice_leading_class, (t_method)voice_leading_topn,
+                    gensym("topn"), A_FLOAT, 0);
+    class_addmethod(voice_leading_class, (t_method)voice_leading_metric,
+                    gensym("metric"), A_DEFSYM, 0);
+    class_addmethod(voice_leading_class, (t_method)voice_leading_modulus,
+                    gensym("modulus"), A_DEFFLOAT, 0);
+    class_addmethod(voice_leading_class, (t_method)voice_leading_stamp,
+                    gensym("stamp"), A_FLOAT, 0);
+    class_addmethod(voice_leading_class, (t_method)voice_leading_variation,
+                    gensym("variation"), A_FLOAT, 0);
+    class_addmethod(voice_leading_class, (t_method)voice_leading_progression,
+                    gensym("progression"), A_GIMME, 0);
+    class_addmethod(voice_leading_class, (t_method)voice_leading_beam,
+                    gensym("beam"), A_FLOAT, 0);
+    class_addmethod(voice_leading_class, (t_method)voice_leading_voices,
+                    gensym("voices"), A_GIMME, 0);
+    class_addmethod(voice_leading_class, (t_method)voice_leading_async,
+                    gensym("async"), A_FLOAT, 0);
     class_addbang(voice_leading_class, voice_leading_bang);
 
+    vl_cache_clear(&vl_cache);
+    vl_plan_cache_clear(&vl_plan_cache);
+    if (!vl_table.entries) {
+        char path[MAXPDSTRING];
+        snprintf(path, sizeof(path), "%s/%s",
+                 class_gethelpdir(voice_leading_class), VL_TABLE_FILENAME);
+        int status = vl_table_open(&vl_table, path);
+        if (status == VL_TABLE_OK) {
+            post("voice_leading: mapped precomputed table %s", path);
+        } else if (status == VL_TABLE_STALE) {
+            post("voice_leading: %s is stale (rebuild with 'make table'), using live search",
+                 path);
+        } else {
+            post("voice_leading: no %s, using live search", VL_TABLE_FILENAME);
+        }
+    }
+
     post("voice_leading external loaded (nonbijective algorithm)");
-    post("Usage: [voice_leading]");
+    post("Usage: [voice_leading <voices>] (default %d, up to %d)", VL_MAX_VOICES,
+         VL_MAX_ENSEMBLE);
     post("  'current <pitches>' - set current chord (any size)");
     post("  'target <pcs>' - set target as absolute pitch classes (any size)");
     post("  'root <pc>' + 'chord <intervals>' - set target as root+intervals");
     post("  'feedback <0|1>' - enable/disable feedback");
     post("  'debug <0|1>' - enable/disable debug output");
+    post("  'cache [clear]' - report cache hits/misses/evictions/table hits (or clear it)");
+    post("  'stats [reset]' - report search times (engine calls hits total_ms max_us p99_us cost) or clear them");
+    post("  'topn <N>' - pick randomly among the N cheapest voice leadings");
+    post("  'variation <seed>' - reseed the topn choice");
+    post("  'stamp <id>' - tag the next chord for [latprobe]; echoed on info before it");
+    post("  'metric l1|l2|linf' - distance the search minimizes");
+    post("  'modulus <n>' - equal divisions of the octave (12, 19, 24, 31...)");
+    post("  'progression <chord names>' - voice a whole sequence for least total motion");
+    post("  'beam <N>' - paths progression keeps per chord (0 = exact)");
+    post("  'voices <N> [budget]' - always N voices, doubling/omitting (0 = off)");
+    post("  'async <0|1>' - search on a worker thread, results follow from the scheduler");
     post("Outlets: [root (MIDI)] [chord (list)] [info (list)]");
     post("Output chord format: [root_pitch, third_pitch, fifth_pitch, seventh_pitch]");
     post("NEW: Supports unequal voice counts (3-voice to 4-voice, etc.)");
@@ -0,0 +1,1688 @@
+// libvoicelead - see voicelead.h
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "voicelead.h"
+#include "vl_simd.h"
+
+#define FORBIDDEN_COST 1000000   // Pairing the assignment solver must never choose
+
+// ---------------------------------------------------------------------------
+// Distance metrics
+
+const char *const vl_metric_names[VL_METRIC_COUNT] = { "l1", "l2", "linf", "weighted" };
+
+void vl_metric_default(vl_metric_t *metric) {
+    metric->kind = VL_METRIC_L1;
+    for (int v = 0; v < VL_MAX_VOICES; v++) {
+        metric->weights[v] = 1;
+    }
+}
+
+int vl_metric_set(vl_metric_t *metric, const char *name, const int *weights, int count) {
+    int kind = -1;
+    for (int k = 0; k < VL_METRIC_COUNT; k++) {
+        if (strcmp(name, vl_metric_names[k]) == 0) kind = k;
+    }
+    if (kind < 0 || count > VL_MAX_VOICES) return -1;
+    for (int v = 0; v < count; v++) {
+        if (weights[v] < 0) return -1;
+    }
+
+    metric->kind = kind;
+    for (int v = 0; v < VL_MAX_VOICES; v++) {
+        metric->weights[v] = v < count ? weights[v] : 1;
+    }
+    return 0;
+}
+
+// A metric is the cost of one voice moving d semitones with weight w, and
+// how those costs fold into a total. Each kernel below is a macro taking
+// the two, stamped out once per metric with VL_METRICS, so the metric is
+// chosen once per call and the L1 loops are the plain sums they always were.
+#define CELL_L1(d, w) (d)
+#define CELL_L2(d, w) ((d) * (d))
+#define CELL_LINF(d, w) (d)
+#define CELL_WEIGHTED(d, w) ((d) * (w))
+#define FOLD_SUM(total, cell) ((total) + (cell))
+#define FOLD_MAX(total, cell) ((total) > (cell) ? (total) : (cell))
+
+// In VL_METRIC_* order
+#define VL_METRICS(X) \
+    X(l1, CELL_L1, FOLD_SUM) \
+    X(l2, CELL_L2, FOLD_SUM) \
+    X(linf, CELL_LINF, FOLD_MAX) \
+    X(weighted, CELL_WEIGHTED, FOLD_SUM)
+
+#define METRIC_KIND(metric) ((metric) ? (metric)->kind : VL_METRIC_L1)
+
+// The metric's weight for each of pitches by register rank (bass first)
+static void metric_voice_weights(const vl_metric_t *metric, const int *pitches, int size,
+                                 int *weights) {
+    for (int i = 0; i < size; i++) {
+        int rank = 0;
+        for (int j = 0; j < size; j++) {
+            if (pitches[j] < pitches[i] || (pitches[j] == pitches[i] && j < i)) rank++;
+        }
+        weights[i] = METRIC_KIND(metric) == VL_METRIC_WEIGHTED ? metric->weights[rank] : 1;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Working memory
+
+void vl_arena_init(vl_arena_t *arena, void *memory, size_t size) {
+    arena->base = memory;
+    arena->size = size;
+    arena->used = 0;
+}
+
+void *vl_arena_alloc(vl_arena_t *arena, size_t bytes) {
+    bytes = VL_ARENA_ROUND(bytes);
+    if (bytes > arena->size - arena->used) return NULL;
+    void *p = arena->base + arena->used;
+    arena->used += bytes;
+    return p;
+}
+
+int vl_scratch_init(vl_scratch_t *scratch, vl_arena_t *arena, int capacity) {
+    if (capacity < 1 || capacity > VL_MAX_SIZE ||
+        arena->size - arena->used < VL_SCRATCH_BYTES(capacity)) {
+        return -1;
+    }
+    scratch->row = vl_arena_alloc(arena, (size_t)VL_DP_SIZE * sizeof(int));
+    scratch->moves = vl_arena_alloc(arena, (size_t)(capacity + 1) * VL_DP_ROW_BYTES);
+    scratch->rotated = vl_arena_alloc(arena, (size_t)capacity * sizeof(int));
+    scratch->cells = vl_arena_alloc(arena, (size_t)capacity * 2 * VL_DP_SIZE * sizeof(int));
+    scratch->values = vl_arena_alloc(arena, (size_t)capacity * 2 * VL_DP_SIZE * sizeof(int));
+    scratch->first = vl_arena_alloc(arena, (size_t)(capacity + 1) * VL_DP_SIZE * sizeof(int));
+    scratch->last = vl_arena_alloc(arena, (size_t)(capacity + 1) * VL_DP_SIZE * sizeof(int));
+    scratch->memo_keys = vl_arena_alloc(arena, (size_t)VL_FIXED_MEMO * sizeof(int));
+    scratch->memo_costs = vl_arena_alloc(arena, (size_t)VL_FIXED_MEMO * sizeof(int));
+    scratch->capacity = capacity;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Equal divisions of the octave
+
+int vl_modulus_init(vl_modulus_t *m, int modulus) {
+    if (modulus < 2 || modulus > VL_MAX_MODULUS) return -1;
+    m->modulus = modulus;
+    for (int a = 0; a < modulus; a++) {
+        for (int b = 0; b < modulus; b++) {
+            int forward = (b - a + modulus) % modulus;
+            int backward = (a - b + modulus) % modulus;
+            m->distance[a][b] = (unsigned char)(forward < backward ? forward : backward);
+            m->path[a][b] = (signed char)(forward > modulus / 2 ? forward - modulus : forward);
+        }
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Nonbijective DP
+
+// One row of cumulative costs rolls down the target: first row and column
+// straight along, the rest from the cheapest neighbour, with the move that
+// won packed 2 bits per cell the way vl_table.h packs paths. The lists
+// come in closed (see vl_dp_cost), so there are at least two of each. The
+// last cell's own distance is left out rather than subtracted after, which
+// is the same thing for L1 and the only way that works for LINF. Ties go to
+// the diagonal, then to the target step, as the path has always taken them.
+#define DP_KERNEL(name, CELL, FOLD) \
+static int dp_cost_##name(int *row, unsigned char (*moves)[VL_DP_ROW_BYTES], \
+                          const unsigned char (*distance)[VL_MAX_MODULUS], \
+                          const int *source, int source_size, \
+                          const int *target, int target_size) { \
+    const unsigned char *d = distance[target[0]]; \
+    int best = 0; \
+    int left = row[0] = CELL(d[source[0]], 1); \
+    unsigned int bits = 0; \
+    for (int j = 1; j < source_size; j++) { \
+        best = left; \
+        left = row[j] = FOLD(best, CELL(d[source[j]], 1)); \
+        bits |= VL_MOVE_SOURCE << ((j & 3) * 2); \
+        if ((j & 3) == 3) { \
+            moves[0][j >> 2] = (unsigned char)bits; \
+            bits = 0; \
+        } \
+    } \
+    if (source_size & 3) moves[0][(source_size - 1) >> 2] = (unsigned char)bits; \
+    for (int i = 1; i < target_size; i++) { \
+        d = distance[target[i]]; \
+        int above_left = row[0]; \
+        best = row[0]; \
+        left = row[0] = FOLD(best, CELL(d[source[0]], 1)); \
+        bits = VL_MOVE_TARGET; \
+        for (int j = 1; j < source_size; j++) { \
+            int above = row[j]; \
+            int move = above < above_left ? VL_MOVE_TARGET : VL_MOVE_DIAGONAL; \
+            best = above < above_left ? above : above_left; \
+            move = left < best ? VL_MOVE_SOURCE : move; \
+            best = left < best ? left : best; \
+            left = row[j] = FOLD(best, CELL(d[source[j]], 1)); \
+            above_left = above; \
+            bits |= (unsigned int)move << ((j & 3) * 2); \
+            if ((j & 3) == 3) { \
+                moves[i][j >> 2] = (unsigned char)bits; \
+                bits = 0; \
+            } \
+        } \
+        if (source_size & 3) moves[i][(source_size - 1) >> 2] = (unsigned char)bits; \
+    } \
+    return best; \
+}
+
+DP_KERNEL(l1, CELL_L1, FOLD_SUM)
+DP_KERNEL(l2, CELL_L2, FOLD_SUM)
+DP_KERNEL(linf, CELL_LINF, FOLD_MAX)
+
+// Pitch classes carry no voice order, so WEIGHTED is L1 here
+static int (*const dp_kernels[VL_METRIC_COUNT])(int *, unsigned char (*)[VL_DP_ROW_BYTES],
+                                                const unsigned char (*)[VL_MAX_MODULUS],
+                                                const int *, int, const int *, int) = {
+    dp_cost_l1, dp_cost_l2, dp_cost_linf, dp_cost_l1
+};
+
+int vl_dp_cost(vl_scratch_t *scratch, int metric, const vl_modulus_t *modulus,
+               const int *source, int source_size,
+               const int *target, int target_size) {
+    int closed_source[VL_DP_SIZE];
+    int closed_target[VL_DP_SIZE];
+    memcpy(closed_source, source, source_size * sizeof(int));
+    memcpy(closed_target, target, target_size * sizeof(int));
+    closed_source[source_size] = source[0];
+    closed_target[target_size] = target[0];
+    return dp_kernels[metric](scratch->row, scratch->moves, modulus->distance,
+                              closed_source, source_size + 1,
+                              closed_target, target_size + 1);
+}
+
+void vl_dp_path(const vl_scratch_t *scratch, int source_size, int target_size,
+                vl_path_t *path) {
+    unsigned char backwards[VL_MAX_PAIRS];
+    int count = 0;
+    int i = target_size;
+    int j = source_size;
+
+    while (i > 0 || j > 0) {
+        int move = (scratch->moves[i][j >> 2] >> ((j & 3) * 2)) & 3;
+        if (move != VL_MOVE_SOURCE) i--;
+        if (move != VL_MOVE_TARGET) j--;
+        backwards[count++] = (unsigned char)move;
+    }
+
+    path->move_count = count;
+    for (int step = 0; step < count; step++) {
+        path->moves[step] = backwards[count - 1 - step];
+    }
+}
+
+// Cyclic alignment. Row k of the doubled grid is target[k % n] and column
+// m is source[0] again, so rotation r is the closed DP from (r, 0) to
+// (r + n, m). Two cheapest paths that cross can trade the stretch between
+// crossings without either getting dearer, so rotation r's path can be
+// taken between those of any rotations below and above it, and the bands
+// the halving visits only overlap on their edges.
+
+#define CYCLIC_NONE (INT_MAX / 2)   // Outside the band; never overflows a sum
+
+// Rotation r's cheapest path over rows r..r + n, kept to rows
+// top[j]..bottom[j] of column j (of m + 1); records the rows it visits per
+// column in first/last and returns its cost less the last cell, as
+// vl_dp_cost counts it
+static int cyclic_path(vl_scratch_t *scratch, int r, int n, int m,
+                       const int *top, const int *bottom, int *first, int *last) {
+    int (*cells)[VL_DP_SIZE] = scratch->cells;
+    int (*v)[VL_DP_SIZE] = scratch->values;
+    int lo[VL_DP_SIZE];
+    int hi[VL_DP_SIZE];
+
+    for (int j = 0; j <= m; j++) {
+        lo[j] = top[j] > r ? top[j] : r;
+        hi[j] = bottom[j] < r + n ? bottom[j] : r + n;
+    }
+    v[r][0] = cells[r][0];
+    for (int k = r + 1; k <= hi[0]; k++) {
+        v[k][0] = v[k-1][0] + cells[k][0];
+    }
+    for (int j = 1; j <= m; j++) {
+        // The band only moves down, so column j - 1 covers everything
+        // from lo[j] - 1 to its own end
+        int k = lo[j];
+        int up = CYCLIC_NONE;
+        int diagonal = k > lo[j-1] ? v[k-1][j-1] : CYCLIC_NONE;
+        for (; k <= hi[j]; k++) {
+            int left = k <= hi[j-1] ? v[k][j-1] : CYCLIC_NONE;
+            int best = up < left ? up : left;
+            if (diagonal < best) best = diagonal;
+            up = v[k][j] = best + cells[k][j];
+            diagonal = left;
+        }
+    }
+
+    // Back along the cheapest predecessors, noting where each column starts
+    int k = r + n;
+    int j = m;
+    last[j] = k;
+    while (k > r || j > 0) {
+        int next_k = k - 1;
+        int next_j = j;
+        int best = k > lo[j] ? v[k-1][j] : CYCLIC_NONE;
+        if (j > 0 && k > lo[j-1] && k - 1 <= hi[j-1] && v[k-1][j-1] <= best) {
+            best = v[k-1][j-1];
+            next_j = j - 1;
+        }
+        if (j > 0 && k >= lo[j-1] && k <= hi[j-1] && v[k][j-1] < best) {
+            next_k = k;
+            next_j = j - 1;
+        }
+        if (next_j != j) {
+            first[j] = k;
+            last[next_j] = next_k;
+        }
+        k = next_k;
+        j = next_j;
+    }
+    first[0] = r;
+    return v[r + n][m] - cells[r + n][m];
+}
+
+// Every rotation strictly between lo and hi, whose paths are known
+static void cyclic_between(vl_scratch_t *scratch, int lo, int hi, int n, int m, int *costs) {
+    if (hi - lo < 2) return;
+    int mid = (lo + hi) / 2;
+    costs[mid] = cyclic_path(scratch, mid, n, m, scratch->first[lo], scratch->last[hi],
+                             scratch->first[mid], scratch->last[mid]);
+    cyclic_between(scratch, lo, mid, n, m, costs);
+    cyclic_between(scratch, mid, hi, n, m, costs);
+}
+
+int vl_dp_cyclic(vl_scratch_t *scratch, int metric, const vl_modulus_t *modulus,
+                 const int *source, int source_size,
+                 const int *target, int target_size, int *costs) {
+    int n = target_size;
+    int m = source_size;
+    int top[VL_DP_SIZE];
+    int bottom[VL_DP_SIZE];
+
+    if (metric == VL_METRIC_LINF) return -1;
+    for (int k = 0; k < n; k++) {
+        const unsigned char *distance = modulus->distance[target[k]];
+        int *cells = scratch->cells[k];
+        if (metric == VL_METRIC_L2) {
+            for (int j = 0; j < m; j++) cells[j] = CELL_L2(distance[source[j]], 1);
+        } else {
+            for (int j = 0; j < m; j++) cells[j] = CELL_L1(distance[source[j]], 1);
+        }
+        cells[m] = cells[0];
+        memcpy(scratch->cells[k + n], cells, (m + 1) * sizeof(int));
+    }
+
+    // Rotation n is rotation 0 a whole target further down
+    for (int j = 0; j < VL_DP_SIZE; j++) {
+        top[j] = 0;
+        bottom[j] = 2 * n - 1;
+    }
+    costs[0] = cyclic_path(scratch, 0, n, m, top, bottom, scratch->first[0], scratch->last[0]);
+    for (int j = 0; j <= m; j++) {
+        scratch->first[n][j] = scratch->first[0][j] + n;
+        scratch->last[n][j] = scratch->last[0][j] + n;
+    }
+    cyclic_between(scratch, 0, n, n, m, costs);
+    return 0;
+}
+
+static void rotate_target(vl_scratch_t *scratch, const int *target, int target_size,
+                          int inversion) {
+    for (int i = 0; i < target_size; i++) {
+        scratch->rotated[i] = target[(i + inversion) % target_size];
+    }
+}
+
+void vl_dp_rotations(vl_scratch_t *scratch, int metric, const vl_modulus_t *modulus,
+                     const int *source, int source_size,
+                     const int *target, int target_size, int *costs) {
+    if (vl_simd_dp_rotations(metric, modulus->modulus, source, source_size,
+                             target, target_size, costs) == 0) {
+        return;
+    }
+    if (target_size >= VL_CYCLIC_MIN &&
+        vl_dp_cyclic(scratch, metric, modulus, source, source_size,
+                     target, target_size, costs) == 0) {
+        return;
+    }
+    for (int inversion = 0; inversion < target_size; inversion++) {
+        rotate_target(scratch, target, target_size, inversion);
+        costs[inversion] = vl_dp_cost(scratch, metric, modulus, source, source_size,
+                                      scratch->rotated, target_size);
+    }
+}
+
+// Costs of every inversion come from vl_dp_rotations; only the winner's
+// DP is rerun for its path
+int vl_search(vl_scratch_t *scratch, int metric, const vl_modulus_t *modulus,
+              const int *source, int source_size,
+              const int *target, int target_size,
+              vl_path_t *best) {
+    int costs[VL_MAX_SIZE];
+    best->cost = VL_VERYLARGENUMBER;
+    best->rotation = 0;
+    best->move_count = 0;
+
+    vl_dp_rotations(scratch, metric, modulus, source, source_size, target, target_size, costs);
+
+    // First strictly better inversion wins
+    for (int inversion = 0; inversion < target_size; inversion++) {
+        if (costs[inversion] < best->cost) {
+            best->cost = costs[inversion];
+            best->rotation = inversion;
+        }
+    }
+    if (target_size > 0) {
+        rotate_target(scratch, target, target_size, best->rotation);
+        vl_dp_cost(scratch, metric, modulus, source, source_size, scratch->rotated, target_size);
+        vl_dp_path(scratch, source_size, target_size, best);
+    }
+    return best->cost;
+}
+
+unsigned int vl_random(unsigned int *state) {
+    unsigned int r = *state;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    *state = r;
+    return r;
+}
+
+// Candidate for the topn heap: one target inversion and its cost
+typedef struct {
+    int cost;
+    int inversion;
+} vl_candidate_t;
+
+// Heap order: worse (higher cost, then later inversion) nearer the root
+static int candidate_worse(const vl_candidate_t *a, const vl_candidate_t *b) {
+    return a->cost != b->cost ? a->cost > b->cost : a->inversion > b->inversion;
+}
+
+// Offer a candidate to a bounded max-heap of the N cheapest seen so far;
+// once full, only something better than the current worst gets in
+static void heap_offer(vl_candidate_t *heap, int *count, int capacity,
+                       vl_candidate_t c) {
+    int i;
+    if (*count < capacity) {
+        i = (*count)++;
+        while (i > 0 && candidate_worse(&c, &heap[(i - 1) / 2])) {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i] = c;
+        return;
+    }
+    if (!candidate_worse(&heap[0], &c)) return;
+
+    // Replace the root and sift down
+    i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= *count) break;
+        if (child + 1 < *count && candidate_worse(&heap[child + 1], &heap[child])) child++;
+        if (!candidate_worse(&heap[child], &c)) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = c;
+}
+
+// Only (cost, inversion) pairs go through the heap; the chosen inversion's
+// DP is rerun once for its path, so nothing is collected or sorted
+int vl_search_topn(vl_scratch_t *scratch, int metric, const vl_modulus_t *modulus,
+                   const int *source, int source_size,
+                   const int *target, int target_size,
+                   int topn, unsigned int *rng, vl_path_t *chosen) {
+    vl_candidate_t heap[VL_TOPN_MAX];
+    int costs[VL_MAX_SIZE];
+    int count = 0;
+    if (topn > VL_TOPN_MAX) topn = VL_TOPN_MAX;
+
+    vl_dp_rotations(scratch, metric, modulus, source, source_size, target, target_size, costs);
+    for (int inversion = 0; inversion < target_size; inversion++) {
+        vl_candidate_t c;
+        c.cost = costs[inversion];
+        c.inversion = inversion;
+        heap_offer(heap, &count, topn, c);
+    }
+    if (count == 0) {
+        chosen->cost = 0;
+        chosen->rotation = 0;
+        chosen->move_count = 0;
+        return 0;
+    }
+
+    vl_candidate_t pick = heap[vl_random(rng) % count];
+    rotate_target(scratch, target, target_size, pick.inversion);
+    vl_dp_cost(scratch, metric, modulus, source, source_size, scratch->rotated, target_size);
+    vl_dp_path(scratch, source_size, target_size, chosen);
+    chosen->cost = pick.cost;
+    chosen->rotation = pick.inversion;
+    return pick.cost;
+}
+
+int vl_path_pairs(const vl_path_t *path,
+                  const int *source, int source_size,
+                  const int *target, int target_size,
+                  vl_pair_t *vl) {
+    int i = 0;
+    int j = 0;
+    int vl_count = 0;
+
+    vl[vl_count].source_note = source[0];
+    vl[vl_count].target_note = target[path->rotation % target_size];
+    vl_count++;
+
+    // The last step lands on the first pair again
+    for (int step = 0; step < path->move_count - 1; step++) {
+        int move = path->moves[step];
+        if (move != VL_MOVE_SOURCE) i++;
+        if (move != VL_MOVE_TARGET) j++;
+
+        vl[vl_count].source_note = source[j % source_size];
+        vl[vl_count].target_note = target[(i + path->rotation) % target_size];
+        vl_count++;
+    }
+
+    return vl_count;
+}
+
+void vl_bijective_rotations(const vl_modulus_t *modulus,
+                            const int *source, const int *target, int size, int *costs) {
+    if (vl_simd_bijective_rotations(modulus->modulus, source, target, size, costs) == 0) return;
+    for (int r = 0; r < size; r++) {
+        int total = 0;
+        for (int i = 0; i < size; i++) {
+            total += modulus->distance[source[i]][target[(i + r) % size]];
+        }
+        costs[r] = total;
+    }
+}
+
+int vl_bijective(const vl_modulus_t *modulus,
+                 const int *source, const int *target, int size, int *rotation) {
+    int costs[VL_MAX_SIZE];
+    int best_size = VL_VERYLARGENUMBER;
+    *rotation = 0;
+    vl_bijective_rotations(modulus, source, target, size, costs);
+    for (int r = 0; r < size; r++) {
+        if (costs[r] < best_size) {
+            best_size = costs[r];
+            *rotation = r;
+        }
+    }
+    return best_size;
+}
+
+// ---------------------------------------------------------------------------
+// Precomputed table
+
+int vl_table_open(vl_table_t *table, const char *path) {
+    table->entries = NULL;
+    table->map = NULL;
+    table->hits = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return VL_TABLE_MISSING;
+
+    size_t expected = sizeof(vl_table_header_t) +
+                      (size_t)VL_TABLE_CLASSES * VL_TABLE_SETS * sizeof(vl_table_entry_t);
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size == expected) {
+        map = mmap(NULL, expected, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    const vl_table_header_t *header = map;
+    if (map == MAP_FAILED ||
+        memcmp(header->magic, VL_TABLE_MAGIC, 4) != 0 ||
+        header->version != VL_TABLE_VERSION ||
+        header->modulus != VL_TABLE_MODULUS ||
+        header->entry_size != sizeof(vl_table_entry_t) ||
+        header->set_count != VL_TABLE_SETS ||
+        header->class_count != VL_TABLE_CLASSES) {
+        if (map != MAP_FAILED) munmap(map, expected);
+        return VL_TABLE_STALE;
+    }
+
+    vl_table_class_index(table->classes);
+    table->map = map;
+    table->map_bytes = expected;
+    table->entries = (const vl_table_entry_t *)(header + 1);
+    return VL_TABLE_OK;
+}
+
+void vl_table_close(vl_table_t *table) {
+    if (table->map) munmap(table->map, table->map_bytes);
+    table->map = NULL;
+    table->entries = NULL;
+}
+
+void vl_table_path(const vl_table_t *table, pcset_t canonical_source,
+                   pcset_t canonical_target, vl_path_t *path) {
+    const vl_table_entry_t *e = &table->entries[vl_table_index(
+        table->classes[canonical_source], canonical_target)];
+    int source_size = pcset_size(canonical_source);
+    int target_size = pcset_size(canonical_target);
+
+    path->cost = e->cost;
+    path->rotation = e->rotation;
+    path->move_count = 0;
+    for (int i = 0, j = 0; i < target_size || j < source_size; ) {
+        int move = vl_table_move(e, path->move_count);
+        if (move != VL_MOVE_SOURCE) i++;
+        if (move != VL_MOVE_TARGET) j++;
+        path->moves[path->move_count++] = (unsigned char)move;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// LRU cache
+
+static unsigned int cache_bucket(const vl_cache_key_t *key) {
+    uint64_t h = key->source * 0x9E3779B97F4A7C15ull ^ key->target * 0xC2B2AE3D27D4EB4Full ^
+                 (uint64_t)(key->metric << 8 | key->modulus);
+    return (unsigned int)(h * 0x9E3779B97F4A7C15ull >> 40) & (VL_CACHE_BUCKETS - 1);
+}
+
+static int cache_key_equal(const vl_cache_key_t *a, const vl_cache_key_t *b) {
+    return a->source == b->source && a->target == b->target &&
+           a->metric == b->metric && a->modulus == b->modulus;
+}
+
+void vl_cache_clear(vl_cache_t *c) {
+    for (int i = 0; i < VL_CACHE_BUCKETS; i++) {
+        c->buckets[i] = -1;
+    }
+    c->head = -1;
+    c->tail = -1;
+    c->count = 0;
+    c->hits = 0;
+    c->misses = 0;
+    c->evictions = 0;
+}
+
+static void cache_unlink(vl_cache_t *c, int idx) {
+    vl_cache_entry_t *e = &c->entries[idx];
+    if (e->prev >= 0) c->entries[e->prev].next = e->next;
+    else c->head = e->next;
+    if (e->next >= 0) c->entries[e->next].prev = e->prev;
+    else c->tail = e->prev;
+}
+
+static void cache_push_front(vl_cache_t *c, int idx) {
+    vl_cache_entry_t *e = &c->entries[idx];
+    e->prev = -1;
+    e->next = c->head;
+    if (c->head >= 0) c->entries[c->head].prev = idx;
+    c->head = idx;
+    if (c->tail < 0) c->tail = idx;
+}
+
+// Find an entry and mark it most recently used (NULL on miss)
+const vl_path_t *vl_cache_lookup(vl_cache_t *c, const vl_cache_key_t *key) {
+    for (int idx = c->buckets[cache_bucket(key)]; idx >= 0;
+         idx = c->entries[idx].chain) {
+        if (cache_key_equal(&c->entries[idx].key, key)) {
+            if (c->head != idx) {
+                cache_unlink(c, idx);
+                cache_push_front(c, idx);
+            }
+            c->hits++;
+            return &c->entries[idx].path;
+        }
+    }
+    c->misses++;
+    return NULL;
+}
+
+// Store a result, recycling the least recently used entry when full
+void vl_cache_insert(vl_cache_t *c, const vl_cache_key_t *key, const vl_path_t *path) {
+    int idx;
+    if (c->count < VL_CACHE_CAPACITY) {
+        idx = c->count++;
+    } else {
+        idx = c->tail;
+        cache_unlink(c, idx);
+
+        // Drop it from its hash chain
+        int *link = &c->buckets[cache_bucket(&c->entries[idx].key)];
+        while (*link != idx) link = &c->entries[*link].chain;
+        *link = c->entries[idx].chain;
+
+        c->evictions++;
+    }
+
+    vl_cache_entry_t *e = &c->entries[idx];
+    e->key = *key;
+    e->path = *path;
+
+    unsigned int bucket = cache_bucket(key);
+    e->chain = c->buckets[bucket];
+    c->buckets[bucket] = idx;
+    cache_push_front(c, idx);
+}
+
+// ---------------------------------------------------------------------------
+// Nonbijective pipeline
+
+// Move canonical-frame pairs back up by shift, keeping them ordered from
+// the lowest source PC as the live search does
+static void transpose_pairs(vl_pair_t *vl, int vl_size, int shift, int modulus) {
+    int first = 0;
+    for (int i = 0; i < vl_size; i++) {
+        vl[i].source_note = (vl[i].source_note + shift) % modulus;
+        vl[i].target_note = (vl[i].target_note + shift) % modulus;
+        if (vl[i].source_note < vl[first].source_note) first = i;
+    }
+
+    vl_pair_t rotated[VL_MAX_PAIRS];
+    for (int i = 0; i < vl_size; i++) {
+        rotated[i] = vl[(i + first) % vl_size];
+    }
+    memcpy(vl, rotated, vl_size * sizeof(vl_pair_t));
+}
+
+int vl_nonbijective(vl_context_t *ctx,
+                    const int *source_pitches, int source_size,
+                    const int *target_pcs, int target_size,
+                    vl_pair_t *vl, int *vl_size) {
+    // Sets dedup and sort for free; T_n(A) -> T_n(B) is just A -> B shifted
+    // by n, so every lookup and search happens in the transposition-
+    // normalized frame and is shifted back at the end
+    const vl_modulus_t *modulus = ctx->modulus;
+    int n = modulus->modulus;
+    pcset_t canonical_source, canonical_target;
+    int shift;
+    pcset_canonical_pair(pcset_from_pitches(source_pitches, source_size, n),
+                         pcset_from_pitches(target_pcs, target_size, n),
+                         n, &canonical_source, &canonical_target, &shift);
+
+    int source[VL_MAX_SIZE];
+    int target[VL_MAX_SIZE];
+    int unique_source_size = pcset_members(canonical_source, source);
+    int unique_target_size = pcset_members(canonical_target, target);
+
+    vl_path_t path;
+    const vl_path_t *hit;
+    vl_cache_key_t key = { canonical_source, canonical_target, ctx->metric, n };
+
+    if (ctx->topn > 1) {
+        // The table and cache only hold the best answer
+        vl_search_topn(ctx->scratch, ctx->metric, modulus, source, unique_source_size,
+                       target, unique_target_size, ctx->topn, ctx->rng, &path);
+    } else if (ctx->table && ctx->table->entries && ctx->metric == VL_METRIC_L1 &&
+               n == VL_TABLE_MODULUS) {
+        vl_table_path(ctx->table, canonical_source, canonical_target, &path);
+        ctx->table->hits++;
+    } else if (ctx->cache && (hit = vl_cache_lookup(ctx->cache, &key))) {
+        path = *hit;
+    } else {
+        vl_search(ctx->scratch, ctx->metric, modulus, source, unique_source_size,
+                  target, unique_target_size, &path);
+        if (ctx->cache) vl_cache_insert(ctx->cache, &key, &path);
+    }
+
+    *vl_size = vl_path_pairs(&path, source, unique_source_size,
+                             target, unique_target_size, vl);
+    transpose_pairs(vl, *vl_size, shift, n);
+    return path.cost;
+}
+
+int vl_apply(const vl_modulus_t *modulus, const int *pitches, int size,
+             const vl_pair_t *vl, int vl_size, int *output) {
+    int n = modulus->modulus;
+    int used[VL_MAX_ENSEMBLE] = {0};
+    int output_size = 0;
+
+    // For each voice pair, find the closest input pitch with matching PC
+    for (int i = 0; i < vl_size; i++) {
+        int source_pc = vl[i].source_note % n;
+        int target_pc = vl[i].target_note % n;
+
+        int best_input_idx = -1;
+        int best_distance = VL_VERYLARGENUMBER;
+
+        for (int j = 0; j < size; j++) {
+            if (used[j]) continue;
+            if (pc_mod(pitches[j], n) == source_pc) {
+                int distance = abs(pitches[j] - target_pc);
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best_input_idx = j;
+                }
+            }
+        }
+
+        if (best_input_idx >= 0) {
+            used[best_input_idx] = 1;
+
+            // Nearest occurrence of the target PC
+            int input_pitch = pitches[best_input_idx];
+            output[output_size++] = input_pitch + modulus->path[source_pc][target_pc];
+        }
+    }
+    return output_size;
+}
+
+int vl_reorder_by_function(int modulus, const int *chord, int size,
+                           int root, const int *structure, int structure_size,
+                           int *output) {
+    if (structure_size == 0) {
+        memcpy(output, chord, size * sizeof(int));
+        return size;
+    }
+
+    // Map each structure interval to the lowest pitch that matches
+    int function_pitches[VL_MAX_ENSEMBLE];
+    int function_found[VL_MAX_ENSEMBLE] = {0};
+
+    for (int i = 0; i < size; i++) {
+        int pc = pc_mod(chord[i], modulus);
+        for (int j = 0; j < structure_size; j++) {
+            if (pc == pc_mod(root + structure[j], modulus)) {
+                if (!function_found[j] || chord[i] < function_pitches[j]) {
+                    function_pitches[j] = chord[i];
+                    function_found[j] = 1;
+                }
+                break;
+            }
+        }
+    }
+
+    int output_size = 0;
+    for (int i = 0; i < structure_size; i++) {
+        if (function_found[i]) {
+            output[output_size++] = function_pitches[i];
+        }
+    }
+    return output_size;
+}
+
+// ---------------------------------------------------------------------------
+// Fixed voice count
+
+#define FIXED_INFINITY (INT_MAX / 4)
+
+typedef struct _fixed_search {
+    int voices;
+    int pcs;                                         // Distinct target PCs
+    int need;                                        // Distinct PCs an answer covers
+    int cells[VL_MAX_SIZE][VL_MAX_SIZE];             // Voice onto target PC
+    unsigned char order[VL_MAX_SIZE][VL_MAX_SIZE];   // Each voice's PCs, cheapest first
+    int floor[VL_MAX_SIZE + 1];                      // Least voices i.. can fold to
+    unsigned int *memo_keys;
+    int *memo_costs;
+    long nodes;
+    long budget;
+} fixed_search_t;
+
+// Slot of (voice, covered); key 0 marks an empty slot
+static unsigned int fixed_key(int voice, unsigned int covered) {
+    return (covered << 5 | (unsigned int)voice) + 1;
+}
+
+static unsigned int fixed_slot(unsigned int key) {
+    return (unsigned int)(key * 0x9E3779B97F4A7C15ull >> 40) & (VL_FIXED_MEMO - 1);
+}
+
+// Each voice's PCs by cell, cheapest first (stable)
+static void fixed_order(fixed_search_t *s) {
+    for (int v = 0; v < s->voices; v++) {
+        unsigned char *order = s->order[v];
+        for (int c = 0; c < s->pcs; c++) {
+            int k = c;
+            while (k > 0 && s->cells[v][order[k - 1]] > s->cells[v][c]) {
+                order[k] = order[k - 1];
+                k--;
+            }
+            order[k] = (unsigned char)c;
+        }
+    }
+}
+
+// Cheapest voice-by-voice cover of s->need PCs: repeatedly the cheapest
+// (free voice, uncovered PC) pair, then every free voice to its nearest PC
+static void fixed_greedy(const fixed_search_t *s, int *choice) {
+    unsigned int covered = 0;
+    for (int v = 0; v < s->voices; v++) choice[v] = -1;
+    for (int count = 0; count < s->need; count++) {
+        int best_v = -1, best_c = -1;
+        for (int v = 0; v < s->voices; v++) {
+            if (choice[v] >= 0) continue;
+            for (int c = 0; c < s->pcs; c++) {
+                if ((covered >> c & 1) == 0 &&
+                    (best_v < 0 || s->cells[v][c] < s->cells[best_v][best_c])) {
+                    best_v = v;
+                    best_c = c;
+                }
+            }
+        }
+        choice[best_v] = best_c;
+        covered |= 1u << best_c;
+    }
+    for (int v = 0; v < s->voices; v++) {
+        if (choice[v] < 0) choice[v] = s->order[v][0];
+    }
+}
+
+// What the voices still to place must stay under for cell folded with
+// them to beat bound: bound - cell for sums, bound itself for maxima
+#define FIXED_LIMIT(FOLD, bound, cell) ((bound) - (FOLD(cell, cell) - (cell)))
+
+// fixed_best returns the exact best cost from (voice, covered) when it is
+// under limit, and something at or above limit otherwise; only exact
+// answers go in the memo, and none once the budget has run out.
+#define FIXED_KERNEL(name, CELL, FOLD) \
+static void fixed_cells_##name(fixed_search_t *s, const vl_modulus_t *modulus, \
+                               const int *source, const int *pcs) { \
+    s->floor[s->voices] = 0; \
+    for (int v = s->voices - 1; v >= 0; v--) { \
+        int source_pc = pc_mod(source[v], modulus->modulus); \
+        int least = FIXED_INFINITY; \
+        for (int c = 0; c < s->pcs; c++) { \
+            s->cells[v][c] = CELL(modulus->distance[source_pc][pcs[c]], 1); \
+            if (s->cells[v][c] < least) least = s->cells[v][c]; \
+        } \
+        s->floor[v] = FOLD(least, s->floor[v + 1]); \
+    } \
+} \
+\
+static int fixed_best_##name(fixed_search_t *s, int voice, unsigned int covered, int limit) { \
+    if (voice == s->voices) return pcset_size(covered) >= s->need ? 0 : FIXED_INFINITY; \
+    unsigned int key = fixed_key(voice, covered); \
+    unsigned int slot = fixed_slot(key); \
+    if (s->memo_keys[slot] == key) return s->memo_costs[slot]; \
+    if (s->floor[voice] >= limit) return limit; \
+    if (++s->nodes > s->budget) return FIXED_INFINITY; \
+    int best = FIXED_INFINITY; \
+    int left = s->voices - voice - 1; \
+    for (int k = 0; k < s->pcs; k++) { \
+        int c = s->order[voice][k]; \
+        int cell = s->cells[voice][c]; \
+        int bound = best < limit ? best : limit; \
+        if (FOLD(cell, s->floor[voice + 1]) >= bound) break; \
+        unsigned int next = covered | 1u << c; \
+        if (s->need - pcset_size(next) > left) continue; \
+        int rest = fixed_best_##name(s, voice + 1, next, FIXED_LIMIT(FOLD, bound, cell)); \
+        if (rest < FIXED_INFINITY && FOLD(cell, rest) < best) best = FOLD(cell, rest); \
+    } \
+    if ((best < limit || limit == FIXED_INFINITY) && s->nodes <= s->budget) { \
+        s->memo_keys[slot] = key; \
+        s->memo_costs[slot] = best; \
+    } \
+    return best; \
+} \
+\
+static int fixed_search_##name(fixed_search_t *s, const vl_modulus_t *modulus, \
+                               const int *source, const int *pcs, int *choice) { \
+    fixed_cells_##name(s, modulus, source, pcs); \
+    fixed_order(s); \
+    int cost = fixed_best_##name(s, 0, 0, FIXED_INFINITY); \
+    if (s->nodes > s->budget) { \
+        fixed_greedy(s, choice); \
+        cost = 0; \
+        for (int v = 0; v < s->voices; v++) cost = FOLD(cost, s->cells[v][choice[v]]); \
+        return cost; \
+    } \
+    long nodes = s->nodes; \
+    s->budget = LONG_MAX; \
+    unsigned int covered = 0; \
+    int left = cost; \
+    for (int v = 0; v < s->voices; v++) { \
+        for (int k = 0; k < s->pcs; k++) { \
+            int c = s->order[v][k]; \
+            unsigned int next = covered | 1u << c; \
+            if (s->need - pcset_size(next) > s->voices - v - 1) continue; \
+            int rest = fixed_best_##name(s, v + 1, next, FIXED_INFINITY); \
+            if (rest < FIXED_INFINITY && FOLD(s->cells[v][c], rest) == left) { \
+                choice[v] = c; \
+                covered = next; \
+                left = rest; \
+                break; \
+            } \
+        } \
+    } \
+    s->nodes = nodes; \
+    return cost; \
+}
+
+VL_METRICS(FIXED_KERNEL)
+
+#define FIXED_ENTRY(name, CELL, FOLD) fixed_search_##name,
+static int (*const fixed_kernels[])(fixed_search_t *, const vl_modulus_t *,
+                                    const int *, const int *, int *) = {
+    VL_METRICS(FIXED_ENTRY)
+};
+
+int vl_fixed_voices(vl_scratch_t *scratch, int metric, const vl_modulus_t *modulus,
+                    const int *current, int current_size,
+                    const int *target_pcs, int target_size,
+                    int voices, long budget, int *output, long *nodes) {
+    int pcs[VL_MAX_MODULUS];
+    int source[VL_MAX_SIZE];
+    int choice[VL_MAX_SIZE];
+    fixed_search_t s;
+
+    *nodes = 0;
+    if (metric < 0 || metric >= VL_METRIC_WEIGHTED || voices < 1 ||
+        voices > scratch->capacity || current_size < 1 || current_size > VL_MAX_ENSEMBLE ||
+        target_size < 1) {
+        return -1;
+    }
+    s.pcs = pcset_members(pcset_from_pitches(target_pcs, target_size, modulus->modulus), pcs);
+    if (s.pcs > VL_MAX_SIZE) return -1;
+
+    // Voice i stays voice i when the count already matches
+    if (current_size == voices) {
+        memcpy(source, current, voices * sizeof(int));
+    } else {
+        int sorted[VL_MAX_ENSEMBLE];
+        for (int i = 0; i < current_size; i++) {
+            int k = i;
+            while (k > 0 && sorted[k - 1] > current[i]) {
+                sorted[k] = sorted[k - 1];
+                k--;
+            }
+            sorted[k] = current[i];
+        }
+        for (int i = 0; i < voices; i++) source[i] = sorted[i % current_size];
+    }
+
+    s.voices = voices;
+    s.need = voices < s.pcs ? voices : s.pcs;
+    s.memo_keys = scratch->memo_keys;
+    s.memo_costs = scratch->memo_costs;
+    memset(s.memo_keys, 0, VL_FIXED_MEMO * sizeof(unsigned int));
+    s.nodes = 0;
+    s.budget = budget;
+
+    int cost = fixed_kernels[metric](&s, modulus, source, pcs, choice);
+    for (int v = 0; v < voices; v++) {
+        int source_pc = pc_mod(source[v], modulus->modulus);
+        output[v] = source[v] + modulus->path[source_pc][pcs[choice[v]]];
+    }
+    *nodes = s.nodes;
+    return cost;
+}
+
+// ---------------------------------------------------------------------------
+// Orbifold
+
+int vl_place_around_centroid(int pitch_class, float centroid) {
+    int best_note = 60;  // default to middle C
+    float min_distance = 10000.0f;
+    int base_octave = (int)(centroid / 12.0f);
+
+    // Test octaves around the centroid
+    for (int oct_offset = -2; oct_offset <= 2; oct_offset++) {
+        int octave = base_octave + oct_offset;
+        if (octave < 2 || octave > 6) continue;
+
+        int candidate = octave * 12 + pitch_class;
+        float distance = candidate > centroid ? candidate - centroid : centroid - candidate;
+
+        if (distance < min_distance) {
+            min_distance = distance;
+            best_note = candidate;
+        }
+    }
+
+    return best_note;
+}
+
+// Each current note grabs the closest unused target, in order. Nearest
+// is nearest under every metric; only the total differs.
+#define GREEDY_KERNEL(name, CELL, FOLD) \
+static int assign_greedy_##name(const int *current, int current_size, \
+                                const int *target, int target_size, \
+                                const int *weights, int *mapping) { \
+    int total_distance = 0; \
+    int used[VL_MAX_VOICES] = {0}; \
+    for (int i = 0; i < current_size; i++) { \
+        int best_j = -1; \
+        int min_dist = 10000; \
+        for (int j = 0; j < target_size; j++) { \
+            if (used[j]) continue; \
+            int dist = abs(current[i] - target[j]); \
+            if (dist < min_dist) { \
+                min_dist = dist; \
+                best_j = j; \
+            } \
+        } \
+        mapping[i] = best_j; \
+        if (best_j >= 0) { \
+            used[best_j] = 1; \
+            total_distance = FOLD(total_distance, CELL(min_dist, weights[i])); \
+        } \
+    } \
+    return total_distance; \
+}
+
+// DP over subsets of the larger side: with at most VL_MAX_VOICES notes
+// per side there are 2^8 = 256 states. cost[mask] is the cheapest way to
+// match the first popcount(mask) notes of the smaller side onto mask.
+// weights are per current voice.
+#define EXACT_KERNEL(name, CELL, FOLD) \
+static int assign_exact_##name(const int *current, int current_size, \
+                               const int *target, int target_size, \
+                               const int *weights, int *mapping) { \
+    int cost[1 << VL_MAX_VOICES]; \
+    signed char last[1 << VL_MAX_VOICES]; \
+    int by_target = current_size > target_size; \
+    int small = by_target ? target_size : current_size; \
+    int large = by_target ? current_size : target_size; \
+    int full = -1; \
+    cost[0] = 0; \
+    for (int mask = 1; mask < (1 << large); mask++) { \
+        int k = pcset_size(mask) - 1; \
+        cost[mask] = INT_MAX; \
+        if (k >= small) continue; \
+        for (int bits = mask; bits; bits &= bits - 1) { \
+            int j = pcset_lowest(bits); \
+            int prev = mask & ~(1 << j); \
+            if (cost[prev] == INT_MAX) continue; \
+            int dist = by_target ? CELL(abs(current[j] - target[k]), weights[j]) \
+                                 : CELL(abs(current[k] - target[j]), weights[k]); \
+            if (FOLD(cost[prev], dist) < cost[mask]) { \
+                cost[mask] = FOLD(cost[prev], dist); \
+                last[mask] = j; \
+            } \
+        } \
+        if (k == small - 1 && (full < 0 || cost[mask] < cost[full])) { \
+            full = mask; \
+        } \
+    } \
+    for (int i = 0; i < current_size; i++) { \
+        mapping[i] = -1; \
+    } \
+    if (full < 0) return 0; \
+    for (int mask = full, k = small - 1; mask; k--) { \
+        int j = last[mask]; \
+        if (by_target) mapping[j] = k; \
+        else mapping[k] = j; \
+        mask &= ~(1 << j); \
+    } \
+    return cost[full]; \
+}
+
+VL_METRICS(GREEDY_KERNEL)
+VL_METRICS(EXACT_KERNEL)
+
+typedef int (*assign_kernel_t)(const int *, int, const int *, int, const int *, int *);
+#define GREEDY_ENTRY(name, CELL, FOLD) assign_greedy_##name,
+#define EXACT_ENTRY(name, CELL, FOLD) assign_exact_##name,
+static const assign_kernel_t greedy_kernels[VL_METRIC_COUNT] = { VL_METRICS(GREEDY_ENTRY) };
+static const assign_kernel_t exact_kernels[VL_METRIC_COUNT] = { VL_METRICS(EXACT_ENTRY) };
+
+int vl_assign_greedy(const vl_metric_t *metric,
+                     const int *current, int current_size,
+                     const int *target, int target_size, int *mapping) {
+    int weights[VL_MAX_VOICES];
+    metric_voice_weights(metric, current, current_size, weights);
+    return greedy_kernels[METRIC_KIND(metric)](current, current_size, target, target_size,
+                                                weights, mapping);
+}
+
+int vl_assign_exact(const vl_metric_t *metric,
+                    const int *current, int current_size,
+                    const int *target, int target_size, int *mapping) {
+    int weights[VL_MAX_VOICES];
+    metric_voice_weights(metric, current, current_size, weights);
+    return exact_kernels[METRIC_KIND(metric)](current, current_size, target, target_size,
+                                               weights, mapping);
+}
+
+int vl_centroid_voicing(int root, const int *intervals, int size, float centroid,
+                        int *voicing) {
+    for (int i = 0; i < size; i++) {
+        voicing[i] = vl_place_around_centroid(pc_mod(root + intervals[i], VL_MODULUS),
+                                              centroid);
+    }
+
+    // Sort for canonical ordering
+    for (int i = 0; i < size - 1; i++) {
+        for (int j = i + 1; j < size; j++) {
+            if (voicing[j] < voicing[i]) {
+                int temp = voicing[i];
+                voicing[i] = voicing[j];
+                voicing[j] = temp;
+            }
+        }
+    }
+    return size;
+}
+
+// ---------------------------------------------------------------------------
+// Hungarian
+
+int vl_octave_anchor(const int *current, int current_size,
+                     const int *intervals, int size) {
+    int current_sum = 0;
+    for (int i = 0; i < current_size; i++) {
+        current_sum += current[i];
+    }
+    int current_center = current_sum / current_size;
+
+    // Test each octave and keep the one with minimum displacement
+    int best_octave = 4;
+    int best_displacement = VL_HIGH_COST;
+
+    for (int octave = VL_MIN_OCTAVE; octave <= VL_MAX_OCTAVE; octave++) {
+        int base_note = octave * 12;
+        int target_sum = 0;
+        for (int i = 0; i < size; i++) {
+            target_sum += base_note + intervals[i];
+        }
+        int displacement = abs(target_sum / size - current_center);
+
+        if (displacement < best_displacement) {
+            best_displacement = displacement;
+            best_octave = octave;
+        }
+    }
+
+    return best_octave;
+}
+
+int vl_constrained_voicings(const int *current, int current_size,
+                            const int *intervals, int size,
+                            int *notes, int *count) {
+    int anchor_octave = vl_octave_anchor(current, current_size, intervals, size);
+    int base_note = anchor_octave * 12;
+
+    *count = 0;
+
+    // Close position (all notes in anchor octave)
+    for (int i = 0; i < size; i++) {
+        notes[(*count)++] = base_note + intervals[i];
+    }
+
+    // Bass register drop (lowest voice down an octave)
+    if (*count < VL_MAX_VARIANTS - size && anchor_octave > VL_MIN_OCTAVE) {
+        notes[(*count)++] = base_note + intervals[0] - 12;
+        for (int i = 1; i < size; i++) {
+            notes[(*count)++] = base_note + intervals[i];
+        }
+    }
+
+    // Soprano register lift (highest voice up an octave)
+    if (*count < VL_MAX_VARIANTS - size && anchor_octave < VL_MAX_OCTAVE) {
+        for (int i = 0; i < size - 1; i++) {
+            notes[(*count)++] = base_note + intervals[i];
+        }
+        notes[(*count)++] = base_note + intervals[size-1] + 12;
+    }
+
+    // Open/spread voicing (bass down, soprano up)
+    if (*count < VL_MAX_VARIANTS - size &&
+        anchor_octave > VL_MIN_OCTAVE && anchor_octave < VL_MAX_OCTAVE) {
+        notes[(*count)++] = base_note + intervals[0] - 12;
+        for (int i = 1; i < size - 1; i++) {
+            notes[(*count)++] = base_note + intervals[i];
+        }
+        notes[(*count)++] = base_note + intervals[size-1] + 12;
+    }
+
+    return anchor_octave;
+}
+
+// Kuhn-Munkres with row/column potentials (Jonker-Volgenant style)
+int vl_assignment_solve(int n, int cost[][VL_ASSIGN_MAX], int *col_for_row) {
+    // 1-based; column 0 is the virtual start of each augmenting path
+    int u[VL_ASSIGN_MAX + 1] = {0};
+    int v[VL_ASSIGN_MAX + 1] = {0};
+    int row_for_col[VL_ASSIGN_MAX + 1] = {0};
+    int way[VL_ASSIGN_MAX + 1] = {0};
+
+    for (int i = 1; i <= n; i++) {
+        int min_slack[VL_ASSIGN_MAX + 1];
+        int used[VL_ASSIGN_MAX + 1];
+        for (int j = 0; j <= n; j++) {
+            min_slack[j] = INT_MAX;
+            used[j] = 0;
+        }
+
+        row_for_col[0] = i;
+        int j0 = 0;
+        do {
+            used[j0] = 1;
+            int i0 = row_for_col[j0];
+            int delta = INT_MAX;
+            int j1 = 0;
+
+            for (int j = 1; j <= n; j++) {
+                if (used[j]) continue;
+                int slack = cost[i0-1][j-1] - u[i0] - v[j];
+                if (slack < min_slack[j]) {
+                    min_slack[j] = slack;
+                    way[j] = j0;
+                }
+                if (min_slack[j] < delta) {
+                    delta = min_slack[j];
+                    j1 = j;
+                }
+            }
+
+            for (int j = 0; j <= n; j++) {
+                if (used[j]) {
+                    u[row_for_col[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    min_slack[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (row_for_col[j0] != 0);
+
+        // Flip the augmenting path
+        do {
+            int j1 = way[j0];
+            row_for_col[j0] = row_for_col[j1];
+            j0 = j1;
+        } while (j0);
+    }
+
+    int total = 0;
+    for (int j = 1; j <= n; j++) {
+        col_for_row[row_for_col[j] - 1] = j - 1;
+        total += cost[row_for_col[j] - 1][j - 1];
+    }
+    return total;
+}
+
+// Completeness as a hard constraint
+//
+// Notes are grouped by pitch class. Completeness means no required group
+// may be left entirely to unused notes, so the square problem gets:
+//   - one row per voice (real costs on real notes, forbidden on slack),
+//   - |g|-1 "unused note" rows per required group g and |g| per optional
+//     group, each free on its own group's notes and on slack,
+//   - one slack column per voice beyond the number of required groups,
+//     which soaks up the unused-note rows nobody needs.
+// Any optimal solution therefore covers every required pitch class. When
+// there are fewer voices than required PCs (or more voices than notes)
+// completeness is impossible and it degrades to a plain min-cost matching.
+int vl_assign_complete(int cost_matrix[][VL_MAX_VARIANTS], int rows, int cols,
+                       const int *notes, pcset_t required, int *assignment) {
+    int cost[VL_ASSIGN_MAX][VL_ASSIGN_MAX];
+    int col_for_row[VL_ASSIGN_MAX];
+    int note_pc[VL_MAX_VARIANTS];
+
+    for (int j = 0; j < cols; j++) {
+        note_pc[j] = pc_mod(notes[j], VL_MODULUS);
+    }
+    pcset_t covered = required & pcset_from_pitches(notes, cols, VL_MODULUS);
+    int groups = pcset_size(covered);
+    int n;
+
+    if (rows >= groups && rows <= cols) {
+        n = rows + cols - groups;
+
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < n; j++) {
+                cost[i][j] = (j < cols) ? cost_matrix[i][j] : FORBIDDEN_COST;
+            }
+        }
+
+        // Unused-note rows: skip the first note of each required group
+        int dummy = rows;
+        pcset_t skipped = 0;
+        for (int g = 0; g < cols; g++) {
+            if (pcset_contains(covered, note_pc[g]) && !pcset_contains(skipped, note_pc[g])) {
+                skipped |= (pcset_t)1 << note_pc[g];
+                continue;
+            }
+            for (int j = 0; j < n; j++) {
+                cost[dummy][j] = (j >= cols || note_pc[j] == note_pc[g]) ? 0 : FORBIDDEN_COST;
+            }
+            dummy++;
+        }
+    } else {
+        n = rows > cols ? rows : cols;
+
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                if (i >= rows) cost[i][j] = 0;
+                else if (j >= cols) cost[i][j] = VL_HIGH_COST;   // Voice left unassigned
+                else cost[i][j] = cost_matrix[i][j];
+            }
+        }
+    }
+
+    vl_assignment_solve(n, cost, col_for_row);
+
+    int total_cost = 0;
+    for (int i = 0; i < rows; i++) {
+        assignment[i] = (col_for_row[i] < cols) ? col_for_row[i] : -1;
+        if (assignment[i] >= 0) {
+            total_cost += cost_matrix[i][assignment[i]];
+        }
+    }
+    return total_cost;
+}
+
+// Voice -> note costs; columns past count are never worth taking
+#define CELLS_KERNEL(name, CELL, FOLD) \
+static void hungarian_cells_##name(int cost_matrix[][VL_MAX_VARIANTS], \
+                                   const int *current, int current_size, \
+                                   const int *notes, int count, const int *weights) { \
+    for (int voice = 0; voice < current_size; voice++) { \
+        for (int target = 0; target < count; target++) { \
+            cost_matrix[voice][target] = CELL(abs(current[voice] - notes[target]), \
+                                              weights[voice]); \
+        } \
+        for (int target = count; target < VL_MAX_VARIANTS; target++) { \
+            cost_matrix[voice][target] = VL_HIGH_COST; \
+        } \
+    } \
+}
+
+VL_METRICS(CELLS_KERNEL)
+
+typedef void (*cells_kernel_t)(int [][VL_MAX_VARIANTS], const int *, int, const int *, int,
+                               const int *);
+#define CELLS_ENTRY(name, CELL, FOLD) hungarian_cells_##name,
+static const cells_kernel_t cells_kernels[VL_METRIC_COUNT] = { VL_METRICS(CELLS_ENTRY) };
+
+// LINF is not a sum, so Kuhn-Munkres can't minimize it directly. Find the
+// smallest cap on a single move that still leaves a full complete
+// assignment (binary search over the distinct costs, moves above the cap
+// forbidden), then take the least total motion under that cap.
+static int assign_complete_bottleneck(int cost_matrix[][VL_MAX_VARIANTS], int rows, int cols,
+                                      const int *notes, pcset_t required, int *assignment) {
+    int values[VL_MAX_VOICES * VL_MAX_VARIANTS];
+    int value_count = 0;
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            int k = value_count++;
+            while (k > 0 && values[k - 1] > cost_matrix[i][j]) {
+                values[k] = values[k - 1];
+                k--;
+            }
+            values[k] = cost_matrix[i][j];
+        }
+    }
+
+    // A cap can also be met by dropping a required pitch class, which
+    // vl_assign_complete only avoids while it has some other way out
+    pcset_t covered = required & pcset_from_pitches(notes, cols, VL_MODULUS);
+    int complete = rows >= pcset_size(covered) && rows <= cols;
+    int assigned = rows < cols ? rows : cols;
+    int capped[VL_MAX_VOICES][VL_MAX_VARIANTS];
+    int trial[VL_MAX_VOICES];
+    int low = 0, high = value_count - 1;
+    vl_assign_complete(cost_matrix, rows, cols, notes, required, assignment);
+
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        int cap = values[mid];
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < VL_MAX_VARIANTS; j++) {
+                capped[i][j] = cost_matrix[i][j] > cap ? FORBIDDEN_COST : cost_matrix[i][j];
+            }
+        }
+        vl_assign_complete(capped, rows, cols, notes, required, trial);
+
+        int within = 0;
+        pcset_t reached = 0;
+        for (int i = 0; i < rows; i++) {
+            if (trial[i] >= 0 && capped[i][trial[i]] <= cap) {
+                within++;
+                reached |= (pcset_t)1 << pc_mod(notes[trial[i]], VL_MODULUS);
+            }
+        }
+        if (within == assigned && (!complete || (covered & ~reached) == 0)) {
+            memcpy(assignment, trial, rows * sizeof(int));
+            high = mid - 1;
+        } else {
+            low = mid + 1;
+        }
+    }
+
+    int largest = 0;
+    for (int i = 0; i < rows; i++) {
+        if (assignment[i] >= 0 && cost_matrix[i][assignment[i]] > largest) {
+            largest = cost_matrix[i][assignment[i]];
+        }
+    }
+    return largest;
+}
+
+int vl_hungarian(const vl_metric_t *metric,
+                 const int *current, int current_size,
+                 const int *target_pcs, int size,
+                 int *notes, int *count, int *anchor, int *assignment) {
+    int cost_matrix[VL_MAX_VOICES][VL_MAX_VARIANTS];
+    int weights[VL_MAX_VOICES];
+    int kind = METRIC_KIND(metric);
+
+    *anchor = vl_constrained_voicings(current, current_size, target_pcs, size,
+                                      notes, count);
+
+    metric_voice_weights(metric, current, current_size, weights);
+    cells_kernels[kind](cost_matrix, current, current_size, notes, *count, weights);
+
+    pcset_t required = pcset_from_pitches(target_pcs, size, VL_MODULUS);
+    if (kind == VL_METRIC_LINF) {
+        return assign_complete_bottleneck(cost_matrix, current_size, *count, notes,
+                                          required, assignment);
+    }
+    return vl_assign_complete(cost_matrix, current_size, *count, notes,
+                              required, assignment);
+}
+
+// ---------------------------------------------------------------------------
+// Exhaustive voicings
+
+void vl_voicing_rules_default(vl_voicing_rules_t *rules) {
+    rules->low = 36;
+    rules->high = 84;
+    rules->max_span = 36;
+    rules->min_spacing = 1;
+    rules->doubling = VL_DOUBLE_ROOT;
+}
+
+int vl_voicing_rules_set(vl_voicing_rules_t *rules, const int *values, int count) {
+    vl_voicing_rules_t r = *rules;
+    if (count > 0) r.low = values[0];
+    if (count > 1) r.high = values[1];
+    if (count > 2) r.max_span = values[2];
+    if (count > 3) r.min_spacing = values[3];
+    if (count > 4) r.doubling = values[4];
+
+    if (r.low < 0 || r.high > 127 || r.low > r.high || r.max_span < 0 ||
+        r.min_spacing < 0 || r.doubling < VL_DOUBLE_NONE || r.doubling > VL_DOUBLE_ANY) {
+        return -1;
+    }
+    *rules = r;
+    return 0;
+}
+
+typedef struct _voicing_search {
+    const vl_voicing_rules_t *rules;
+    pcset_t chord;
+    pcset_t required;    // Must all appear (empty when voices are too few)
+    pcset_t used;
+    int root;
+    int voices;
+    int counts[VL_MODULUS];
+    int voicing[VL_MAX_VOICES];
+
+    // vl_voicings_enumerate
+    int (*visit)(const int *voicing, void *arg);
+    void *arg;
+    long visited;
+    int stop;
+
+    // vl_voicing_nearest
+    const int *target;   // Sorted current chord
+    int weights[VL_MAX_VOICES];   // Metric weight per voice, bass first
+    int best_cost;
+    int best[VL_MAX_VOICES];
+    long nodes;
+} voicing_search_t;
+
+// Cheapest the voices above depth can still cost once depth sits at pitch:
+// each is held up by the spacing below it and down by the span. Then the
+// depth-first walk itself; without a target it only enumerates, so every
+// metric's copy does the same there.
+#define SEARCH_KERNEL(name, CELL, FOLD) \
+static int voicing_bound_##name(const voicing_search_t *s, int depth, int pitch, \
+                                int bottom) { \
+    int bound = 0; \
+    for (int j = depth + 1; j < s->voices; j++) { \
+        int floor = pitch + (j - depth) * s->rules->min_spacing; \
+        int ceiling = bottom + s->rules->max_span; \
+        if (s->target[j] < floor) { \
+            bound = FOLD(bound, CELL(floor - s->target[j], s->weights[j])); \
+        } else if (s->target[j] > ceiling) { \
+            bound = FOLD(bound, CELL(s->target[j] - ceiling, s->weights[j])); \
+        } \
+    } \
+    return bound; \
+} \
+\
+static void voicing_search_##name(voicing_search_t *s, int depth, int cost) { \
+    const vl_voicing_rules_t *r = s->rules; \
+    if (depth == s->voices) { \
+        if (s->target) { \
+            if (cost < s->best_cost) { \
+                s->best_cost = cost; \
+                memcpy(s->best, s->voicing, s->voices * sizeof(int)); \
+            } \
+        } else { \
+            s->visited++; \
+            if (s->visit(s->voicing, s->arg)) s->stop = 1; \
+        } \
+        return; \
+    } \
+    s->nodes++; \
+    int lowest = depth ? s->voicing[depth - 1] + r->min_spacing : r->low; \
+    int highest = depth ? s->voicing[0] + r->max_span : r->high; \
+    if (highest > r->high) highest = r->high; \
+    int missing = pcset_size(s->required & ~s->used); \
+    int pitches[128]; \
+    int count = 0; \
+    for (int p = lowest; p <= highest; p++) { \
+        int pc = p % VL_MODULUS; \
+        if (!pcset_contains(s->chord, pc)) continue; \
+        if (s->counts[pc] > 0 && r->doubling != VL_DOUBLE_ANY && \
+            !(r->doubling == VL_DOUBLE_ROOT && pc == s->root)) continue; \
+        int still_missing = missing - (pcset_contains(s->required & ~s->used, pc) ? 1 : 0); \
+        if (still_missing > s->voices - depth - 1) continue; \
+        int k = count++; \
+        if (s->target) { \
+            int distance = abs(p - s->target[depth]); \
+            while (k > 0 && abs(pitches[k - 1] - s->target[depth]) > distance) { \
+                pitches[k] = pitches[k - 1]; \
+                k--; \
+            } \
+        } \
+        pitches[k] = p; \
+    } \
+    for (int i = 0; i < count && !s->stop; i++) { \
+        int p = pitches[i]; \
+        int pc = p % VL_MODULUS; \
+        int step_cost = cost; \
+        if (s->target) { \
+            step_cost = FOLD(cost, CELL(abs(p - s->target[depth]), s->weights[depth])); \
+            int bottom = depth ? s->voicing[0] : p; \
+            if (FOLD(step_cost, voicing_bound_##name(s, depth, p, bottom)) >= s->best_cost) { \
+                continue; \
+            } \
+        } \
+        pcset_t used = s->used; \
+        s->voicing[depth] = p; \
+        s->counts[pc]++; \
+        s->used |= (pcset_t)1 << pc; \
+        voicing_search_##name(s, depth + 1, step_cost); \
+        s->counts[pc]--; \
+        s->used = used; \
+    } \
+}
+
+VL_METRICS(SEARCH_KERNEL)
+
+#define SEARCH_ENTRY(name, CELL, FOLD) voicing_search_##name,
+static void (*const search_kernels[VL_METRIC_COUNT])(voicing_search_t *, int, int) = {
+    VL_METRICS(SEARCH_ENTRY)
+};
+
+static void voicing_search_init(voicing_search_t *s, const vl_voicing_rules_t *rules,
+                                const int *pcs, int size, int root, int voices) {
+    memset(s, 0, sizeof(*s));
+    s->rules = rules;
+    s->chord = pcset_from_pitches(pcs, size, VL_MODULUS);
+    s->required = voices >= pcset_size(s->chord) ? s->chord : 0;
+    s->root = pc_mod(root, VL_MODULUS);
+    s->voices = voices;
+}
+
+long vl_voicings_enumerate(const vl_voicing_rules_t *rules,
+                           const int *pcs, int size, int root, int voices,
+                           int (*visit)(const int *voicing, void *arg), void *arg) {
+    if (voices < 1 || voices > VL_MAX_VOICES || size < 1) return 0;
+
+    voicing_search_t s;
+    voicing_search_init(&s, rules, pcs, size, root, voices);
+    s.visit = visit;
+    s.arg = arg;
+    voicing_search_l1(&s, 0, 0);
+    return s.visited;
+}
+
+int vl_voicing_nearest(const vl_metric_t *metric, const vl_voicing_rules_t *rules,
+                       const int *pcs, int size, int root,
+                       const int *current, int current_size,
+                       int *voicing, long *nodes) {
+    *nodes = 0;
+    if (current_size < 1 || current_size > VL_MAX_VOICES || size < 1) return -1;
+
+    int target[VL_MAX_VOICES];
+    memcpy(target, current, current_size * sizeof(int));
+    for (int i = 1; i < current_size; i++) {
+        for (int j = i; j > 0 && target[j - 1] > target[j]; j--) {
+            int t = target[j];
+            target[j] = target[j - 1];
+            target[j - 1] = t;
+        }
+    }
+
+    voicing_search_t s;
+    voicing_search_init(&s, rules, pcs, size, root, current_size);
+    s.target = target;
+    metric_voice_weights(metric, target, current_size, s.weights);
+    s.best_cost = INT_MAX;
+    search_kernels[METRIC_KIND(metric)](&s, 0, 0);
+
+    *nodes = s.nodes;
+    if (s.best_cost == INT_MAX) return -1;
+    memcpy(voicing, s.best, current_size * sizeof(int));
+    return s.best_cost;
+}
+
+void vl_voicing_by_rank(const int *current, int size, const int *voicing, int *moved) {
+    for (int i = 0; i < size; i++) {
+        int rank = 0;
+        for (int j = 0; j < size; j++) {
+            if (current[j] < current[i] || (current[j] == current[i] && j < i)) rank++;
+        }
+        moved[i] = voicing[rank];
+    }
+}
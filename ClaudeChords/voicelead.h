@@ -0,0 +1,446 @@
+// libvoicelead - the voice-leading engines without Pure Data
+//
+// Everything the ClaudeChords externals compute lives here: the
+// nonbijective DP (Tymoczko), the precomputed table and the LRU cache in
+// front of it, orbifold's register placement and assignment, and
+// hungarian's constrained voicings and Kuhn-Munkres solver. Nothing here
+// includes m_pd.h, allocates, or prints; working memory is passed in by the
+// caller (see vl_arena_t and vl_scratch_t), so the same code runs inside an
+// external, a benchmark, a fuzzer or a C++ host.
+//
+// The externals are thin wrappers: they parse messages, call into this
+// library and send the results to their outlets.
+
+#ifndef VOICELEAD_H
+#define VOICELEAD_H
+
+#include <stddef.h>
+#include "pcset.h"
+#include "vl_table.h"
+
+#define VL_MODULUS 12                        // Default EDO; the table's and the planner's
+#define VL_MAX_MODULUS PCSET_MAX_MODULUS     // Widest EDO the nonbijective pipeline takes
+#define VL_MAX_VOICES 8                      // Pitches per chord (voice_leading: by default)
+#define VL_MAX_ENSEMBLE 24                   // Most voices voice_leading can be created with
+#define VL_MAX_SIZE VL_MAX_ENSEMBLE          // Distinct PCs per side of the DP
+#define VL_DP_SIZE (VL_MAX_SIZE + 1)         // DP grid side: the first PC comes round again
+#define VL_DP_ROW_BYTES ((VL_DP_SIZE + 3) / 4)   // One grid row of 2-bit moves
+#define VL_MAX_PAIRS (2 * VL_MAX_SIZE)       // Longest DP path
+#define VL_TOPN_MAX VL_MAX_SIZE              // Most candidates topn can rank
+#define VL_VERYLARGENUMBER 10000
+
+// ---------------------------------------------------------------------------
+// Distance metrics
+//
+// How a voice leading's motions add up. L1 (total semitones moved) is what
+// every engine used originally and stays the default. L2 is reported as
+// the sum of squares, which ranks voicings as the Euclidean norm does while
+// staying an integer; it prefers several small moves to one big one. LINF
+// is the single largest move. WEIGHTED is L1 with a weight per voice,
+// counted from the bass up, e.g. heavier outer voices.
+//
+// Each metric has its own copy of every inner loop (voicelead.c stamps them
+// out from one macro per kernel), picked once per call.
+
+#define VL_METRIC_L1 0
+#define VL_METRIC_L2 1
+#define VL_METRIC_LINF 2
+#define VL_METRIC_WEIGHTED 3
+#define VL_METRIC_COUNT 4
+
+typedef struct _vl_metric {
+    int kind;                     // VL_METRIC_*
+    int weights[VL_MAX_VOICES];   // WEIGHTED: bass first; others ignore them
+} vl_metric_t;
+
+// "l1", "l2", "linf", "weighted"
+extern const char *const vl_metric_names[VL_METRIC_COUNT];
+
+// L1, every weight 1
+void vl_metric_default(vl_metric_t *metric);
+
+// Select a metric by name; weights (bass first, missing ones 1) only for
+// weighted. Returns 0, or -1 (metric unchanged) for an unknown name or a
+// negative weight
+int vl_metric_set(vl_metric_t *metric, const char *name, const int *weights, int count);
+
+// ---------------------------------------------------------------------------
+// Equal divisions of the octave
+//
+// The nonbijective pipeline runs in any n-EDO up to VL_MAX_MODULUS: pitches
+// are steps of 1/n octave and pitch classes run 0..n-1. Every DP cell and
+// every applied move looks its pitch classes up in the modulus's tables
+// instead of taking two remainders. 12-EDO also has the precomputed table;
+// other moduli search live behind the cache.
+
+typedef struct _vl_modulus {
+    int modulus;
+    unsigned char distance[VL_MAX_MODULUS][VL_MAX_MODULUS];   // The shorter way round
+    signed char path[VL_MAX_MODULUS][VL_MAX_MODULUS];         // Signed move a -> b
+                                                              // (half an octave goes up)
+} vl_modulus_t;
+
+// Fill the tables for n-EDO; returns 0, or -1 (untouched) unless
+// 2 <= modulus <= VL_MAX_MODULUS
+int vl_modulus_init(vl_modulus_t *m, int modulus);
+
+// ---------------------------------------------------------------------------
+// Nonbijective voice leading
+
+typedef struct {
+    int source_note;
+    int target_note;
+} vl_pair_t;
+
+// One DP answer in compact form: the target inversion it starts from and
+// the VL_MOVE_* steps from (source 0, target 0) round to the copy of that
+// pair that closes the cycle. The cache and the table both store this;
+// vl_path_pairs turns it back into voice pairs.
+typedef struct _vl_path {
+    int cost;
+    int rotation;
+    int move_count;
+    unsigned char moves[VL_MAX_PAIRS];
+} vl_path_t;
+
+// ---------------------------------------------------------------------------
+// Working memory
+//
+// An arena hands out one caller-provided block front to back and is only
+// ever emptied as a whole, so an external can allocate everything its
+// searches need once, in its constructor, sized for its voice count.
+
+typedef struct _vl_arena {
+    unsigned char *base;   // Aligned for int, as any malloc/getbytes block
+    size_t size;
+    size_t used;
+} vl_arena_t;
+
+#define VL_ARENA_ROUND(bytes) (((bytes) + 15) & ~(size_t)15)
+
+void vl_arena_init(vl_arena_t *arena, void *memory, size_t size);
+
+// bytes (rounded up to 16) from the arena, or NULL when it is full
+void *vl_arena_alloc(vl_arena_t *arena, size_t bytes);
+
+#define VL_FIXED_MEMO 2048   // vl_fixed_voices memo slots (power of two)
+
+// Working memory for one search; one per caller/thread. The DP keeps one
+// rolling row of costs and, per target PC, the 2-bit VL_MOVE_* that
+// reached each cell, so a scratch for capacity PCs per side only takes
+// capacity + 1 rows of 7 bytes.
+typedef struct _vl_scratch {
+    int *row;                     // Rolling DP costs, VL_DP_SIZE
+    unsigned char (*moves)[VL_DP_ROW_BYTES];   // Backpointers, capacity + 1 rows
+    int *rotated;                 // Target in the inversion being tried
+    int (*cells)[VL_DP_SIZE];     // vl_dp_cyclic: cell costs over the target twice
+    int (*values)[VL_DP_SIZE];    // Its path costs, the same 2 * capacity rows
+    int (*first)[VL_DP_SIZE];     // Row each rotation's path enters column j,
+    int (*last)[VL_DP_SIZE];      // and leaves it; capacity + 1 rotations
+    unsigned int *memo_keys;      // vl_fixed_voices: (voice, PCs covered) per slot
+    int *memo_costs;              // Best cost from there on
+    int capacity;                 // Distinct PCs per side it can search
+} vl_scratch_t;
+
+// Arena bytes vl_scratch_init takes for capacity PCs per side
+#define VL_SCRATCH_BYTES(capacity) \
+    (VL_ARENA_ROUND((size_t)VL_DP_SIZE * sizeof(int)) + \
+     VL_ARENA_ROUND((size_t)((capacity) + 1) * VL_DP_ROW_BYTES) + \
+     VL_ARENA_ROUND((size_t)(capacity) * sizeof(int)) + \
+     2 * VL_ARENA_ROUND((size_t)(capacity) * 2 * VL_DP_SIZE * sizeof(int)) + \
+     2 * VL_ARENA_ROUND((size_t)((capacity) + 1) * VL_DP_SIZE * sizeof(int)) + \
+     2 * VL_ARENA_ROUND((size_t)VL_FIXED_MEMO * sizeof(int)))
+
+// Carve a scratch for capacity (1..VL_MAX_SIZE) PCs per side out of the
+// arena; returns 0, or -1 if it doesn't fit
+int vl_scratch_init(vl_scratch_t *scratch, vl_arena_t *arena, int capacity);
+
+// Run the DP for source -> target (sorted PCs), keeping its backpointers
+// in scratch->moves, and return the cost. As in Tymoczko's algorithm each
+// side gets its first PC again at the end, so a path is a cyclic voice
+// leading through (source 0, target 0) and the cheapest over every
+// inversion is the same in any transposition; the closing cell repeats
+// the first pair, so its distance is left out. metric is a VL_METRIC_*
+// kind; the DP has no voice order, so WEIGHTED counts as L1 here.
+int vl_dp_cost(vl_scratch_t *scratch, int metric, const vl_modulus_t *modulus,
+               const int *source, int source_size,
+               const int *target, int target_size);
+
+// Follow the backpointers of the last vl_dp_cost into path->moves
+void vl_dp_path(const vl_scratch_t *scratch, int source_size, int target_size,
+                vl_path_t *path);
+
+// costs[r] = vl_dp_cost of source against target rotated by r, for every
+// inversion, from one DP over the target written out twice (Maes' cyclic
+// alignment): every rotation's path runs between the paths of its
+// neighbours, so after rotation 0 each rotation halfway between two known
+// ones only fills the band between them, O(n m log n) in all. That only
+// holds for costs that add up, so LINF returns -1 (nothing written).
+int vl_dp_cyclic(vl_scratch_t *scratch, int metric, const vl_modulus_t *modulus,
+                 const int *source, int source_size,
+                 const int *target, int target_size, int *costs);
+
+// costs[r] = vl_dp_cost of source against target rotated by r, for every
+// inversion; vectorized across inversions when vl_simd_level() allows,
+// else vl_dp_cyclic for targets of VL_CYCLIC_MIN PCs and up
+#define VL_CYCLIC_MIN 16   // Below this one plain DP per rotation is as fast
+void vl_dp_rotations(vl_scratch_t *scratch, int metric, const vl_modulus_t *modulus,
+                     const int *source, int source_size,
+                     const int *target, int target_size, int *costs);
+
+// Best path over every inversion of target; returns its cost
+int vl_search(vl_scratch_t *scratch, int metric, const vl_modulus_t *modulus,
+              const int *source, int source_size,
+              const int *target, int target_size,
+              vl_path_t *best);
+
+// One of the topn cheapest inversions, chosen with vl_random(rng)
+int vl_search_topn(vl_scratch_t *scratch, int metric, const vl_modulus_t *modulus,
+                   const int *source, int source_size,
+                   const int *target, int target_size,
+                   int topn, unsigned int *rng, vl_path_t *chosen);
+
+// Voice pairs of a path; returns the pair count
+int vl_path_pairs(const vl_path_t *path,
+                  const int *source, int source_size,
+                  const int *target, int target_size,
+                  vl_pair_t *vl);
+
+// Best bijective rotation (source[i] -> target[(i + rotation) % size]) of
+// two equal-sized sorted PC lists; returns its total motion
+int vl_bijective(const vl_modulus_t *modulus,
+                 const int *source, const int *target, int size, int *rotation);
+
+// Total motion of every rotation vl_bijective tries, into costs[r]
+void vl_bijective_rotations(const vl_modulus_t *modulus,
+                            const int *source, const int *target, int size, int *costs);
+
+// Marsaglia xorshift32; state must be non-zero
+unsigned int vl_random(unsigned int *state);
+
+// ---------------------------------------------------------------------------
+// Precomputed table (see vl_table.h)
+
+#define VL_TABLE_OK 0
+#define VL_TABLE_MISSING 1
+#define VL_TABLE_STALE 2
+
+typedef struct _vl_table {
+    const vl_table_entry_t *entries;   // NULL when not mapped
+    void *map;
+    size_t map_bytes;
+    short classes[VL_TABLE_SETS + 1];
+    unsigned long hits;
+} vl_table_t;
+
+// mmap a table file read-only; returns VL_TABLE_OK/MISSING/STALE
+int vl_table_open(vl_table_t *table, const char *path);
+void vl_table_close(vl_table_t *table);
+
+// Path for a canonical (source, target) pair
+void vl_table_path(const vl_table_t *table, pcset_t canonical_source,
+                   pcset_t canonical_target, vl_path_t *path);
+
+// ---------------------------------------------------------------------------
+// LRU cache of live search results, keyed by canonical pair
+
+#define VL_CACHE_CAPACITY 64   // Voice leadings remembered
+#define VL_CACHE_BUCKETS 128   // Hash buckets (power of two)
+
+// What a live result depends on
+typedef struct _vl_cache_key {
+    pcset_t source;   // Canonical pair
+    pcset_t target;
+    int metric;
+    int modulus;
+} vl_cache_key_t;
+
+typedef struct _vl_cache_entry {
+    vl_cache_key_t key;
+    vl_path_t path;
+    int prev;   // LRU neighbour towards most recently used (-1 = head)
+    int next;   // LRU neighbour towards least recently used (-1 = tail)
+    int chain;  // Next entry in the same hash bucket (-1 = end)
+} vl_cache_entry_t;
+
+typedef struct _vl_cache {
+    vl_cache_entry_t entries[VL_CACHE_CAPACITY];
+    int buckets[VL_CACHE_BUCKETS];
+    int head;   // Most recently used
+    int tail;   // Least recently used
+    int count;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+} vl_cache_t;
+
+void vl_cache_clear(vl_cache_t *cache);
+const vl_path_t *vl_cache_lookup(vl_cache_t *cache, const vl_cache_key_t *key);
+void vl_cache_insert(vl_cache_t *cache, const vl_cache_key_t *key, const vl_path_t *path);
+
+// ---------------------------------------------------------------------------
+// Whole nonbijective pipeline, as the voice_leading external runs it
+
+typedef struct _vl_context {
+    vl_table_t *table;       // Precomputed answers, or NULL
+    vl_cache_t *cache;       // Recent live results, or NULL
+    vl_scratch_t *scratch;   // Required, with capacity for both chords
+    int topn;                // > 1: random choice among the topn cheapest
+    unsigned int *rng;       // Used when topn > 1
+    int metric;              // VL_METRIC_*; the table only holds L1 answers
+    const vl_modulus_t *modulus;   // Required; the table only holds 12-EDO
+} vl_context_t;
+
+// Voice leading from source pitches to target PCs (any sizes up to the
+// scratch's capacity, doublings allowed). Works in the transposition-
+// normalized frame and shifts back; pairs start at the lowest source PC.
+// Returns the cost.
+int vl_nonbijective(vl_context_t *ctx,
+                    const int *source_pitches, int source_size,
+                    const int *target_pcs, int target_size,
+                    vl_pair_t *vl, int *vl_size);
+
+// Move actual pitches (at most VL_MAX_ENSEMBLE) along the pairs; returns
+// the output size
+int vl_apply(const vl_modulus_t *modulus, const int *pitches, int size,
+             const vl_pair_t *vl, int vl_size, int *output);
+
+// Lowest pitch of each chord function (root + structure[i], mod modulus)
+// in structure order, or a copy when structure_size is 0; returns the
+// output size
+int vl_reorder_by_function(int modulus, const int *chord, int size,
+                           int root, const int *structure, int structure_size,
+                           int *output);
+
+// ---------------------------------------------------------------------------
+// Fixed voice count
+//
+// vl_nonbijective keeps as many voices as its pairs need, so four voices
+// can come out as three or five. This search keeps the count instead:
+// every voice moves (the short way round) to one of the target's PCs, and
+// together they cover all of them, or as many different ones as there
+// are voices. Extra voices double, missing ones omit, whichever is
+// cheapest under the metric.
+
+// Search nodes whose worst case (24 voices, every state new) stays well
+// inside one 64-sample block, 1.45 ms at 44.1 kHz
+#define VL_FIXED_BUDGET 10000
+
+// Best leading of current onto the target PCs (duplicates ignored) with
+// exactly voices voices (1..scratch capacity). current of another size
+// is sorted first, then doubled from the bass up or trimmed from the top.
+// output[i] is where voice i goes; *nodes counts the search nodes. Voices
+// go bass first, the best cost from each (voice, PCs covered) state is
+// memoized in the scratch, and a branch is cut once it can't beat the
+// best so far. After budget nodes the cheapest greedy cover is returned
+// instead (*nodes > budget says so). Returns the cost under metric
+// (VL_METRIC_*, not weighted), or -1 if the arguments don't fit.
+int vl_fixed_voices(vl_scratch_t *scratch, int metric, const vl_modulus_t *modulus,
+                    const int *current, int current_size,
+                    const int *target_pcs, int target_size,
+                    int voices, long budget, int *output, long *nodes);
+
+// ---------------------------------------------------------------------------
+// Orbifold: fixed-register placement and pitch assignment
+
+// Octave of pitch_class nearest the centroid (octaves 2-6)
+int vl_place_around_centroid(int pitch_class, float centroid);
+
+// Match current pitches to target pitches; mapping[i] is a target index
+// or -1. Every note of the smaller side is matched. Return the motion
+// under metric (NULL: L1).
+int vl_assign_greedy(const vl_metric_t *metric,
+                     const int *current, int current_size,
+                     const int *target, int target_size, int *mapping);
+int vl_assign_exact(const vl_metric_t *metric,
+                    const int *current, int current_size,
+                    const int *target, int target_size, int *mapping);
+
+// root + intervals placed around the centroid, ascending; returns size
+int vl_centroid_voicing(int root, const int *intervals, int size, float centroid,
+                        int *voicing);
+
+// ---------------------------------------------------------------------------
+// Hungarian: constrained voicings and optimal complete assignment
+
+#define VL_MAX_VARIANTS 8    // Candidate target notes
+#define VL_MIN_OCTAVE 2
+#define VL_MAX_OCTAVE 4
+#define VL_HIGH_COST 1000    // Voice left unassigned
+#define VL_ASSIGN_MAX (VL_MAX_VOICES + VL_MAX_VARIANTS)
+
+// Octave whose placement of intervals is closest to the current chord's
+// centre of mass
+int vl_octave_anchor(const int *current, int current_size,
+                     const int *intervals, int size);
+
+// Close, bass-drop, soprano-lift and spread voicings of intervals around
+// the anchor octave; returns the anchor
+int vl_constrained_voicings(const int *current, int current_size,
+                            const int *intervals, int size,
+                            int *notes, int *count);
+
+// Square Kuhn-Munkres, O(n^3); returns the minimum total cost
+int vl_assignment_solve(int n, int cost[][VL_ASSIGN_MAX], int *col_for_row);
+
+// Optimal voice -> note assignment covering every required PC present
+// among the notes whenever there are enough voices. assignment[i] is a
+// column or -1; returns the total cost.
+int vl_assign_complete(int cost[][VL_MAX_VARIANTS], int rows, int cols,
+                       const int *notes, pcset_t required, int *assignment);
+
+// Whole hungarian step: voicings of target_pcs around the current chord
+// (notes/count, anchor octave), then the complete assignment of each
+// current voice to one of them. Returns its cost under metric (NULL: L1);
+// LINF minimizes the largest move first, then the total.
+int vl_hungarian(const vl_metric_t *metric,
+                 const int *current, int current_size,
+                 const int *target_pcs, int size,
+                 int *notes, int *count, int *anchor, int *assignment);
+
+// ---------------------------------------------------------------------------
+// Exhaustive voicings within register rules
+
+#define VL_DOUBLE_NONE 0   // Every voice a different pitch class
+#define VL_DOUBLE_ROOT 1   // Only the root may appear more than once
+#define VL_DOUBLE_ANY 2    // Any chord tone may repeat
+
+typedef struct _vl_voicing_rules {
+    int low;           // Lowest MIDI note
+    int high;          // Highest MIDI note
+    int max_span;      // Bottom voice to top voice
+    int min_spacing;   // Between neighbouring voices (0 allows unisons)
+    int doubling;      // VL_DOUBLE_*
+} vl_voicing_rules_t;
+
+// C2-C6, span of three octaves, no unisons, root doubling
+void vl_voicing_rules_default(vl_voicing_rules_t *rules);
+
+// Override the defaults with up to five values in field order; returns 0,
+// or -1 (rules unchanged) if they contradict each other
+int vl_voicing_rules_set(vl_voicing_rules_t *rules, const int *values, int count);
+
+// Every ascending voicing of the chord (pcs, root among them) with the
+// given number of voices that obeys the rules and, when there are enough
+// voices, contains every chord tone. visit returns nonzero to stop early.
+// Returns how many were visited.
+long vl_voicings_enumerate(const vl_voicing_rules_t *rules,
+                           const int *pcs, int size, int root, int voices,
+                           int (*visit)(const int *voicing, void *arg), void *arg);
+
+// The voicing of that kind nearest current (sorted, one voice per current
+// pitch, distance under metric; NULL: L1), by branch and bound: nearest
+// pitches first, each partial voicing cut as soon as its cost plus a bound
+// for the voices still to place reaches the best found. voicing is
+// ascending; *nodes counts the partial voicings examined. Returns the
+// cost, or -1 if none exists.
+int vl_voicing_nearest(const vl_metric_t *metric, const vl_voicing_rules_t *rules,
+                       const int *pcs, int size, int root,
+                       const int *current, int current_size,
+                       int *voicing, long *nodes);
+
+// Move voice i of current to the voicing note of the same rank (ties keep
+// voice order), so the sorted distance is what the voices actually travel
+void vl_voicing_by_rank(const int *current, int size, const int *voicing, int *moved);
+
+#endif